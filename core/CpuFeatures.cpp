@@ -0,0 +1,35 @@
+#include "CpuFeatures.hpp"
+#include <cstdlib>
+#include <cstring>
+
+SimdLevel detectSimdLevel() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+#endif
+    return SIMD_SCALAR;
+}
+
+SimdLevel activeSimdLevel() {
+    static const SimdLevel level = [] {
+        SimdLevel detected = detectSimdLevel();
+        
+        const char* requested = std::getenv("QUANTUM_SIMD");
+        if (!requested) return detected;
+        
+        SimdLevel limit = detected;
+        if (std::strcmp(requested, "scalar") == 0) limit = SIMD_SCALAR;
+        else if (std::strcmp(requested, "avx2") == 0) limit = SIMD_AVX2;
+        return limit < detected ? limit : detected;
+    }();
+    return level;
+}
+
+const char* getSimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX512: return "AVX-512";
+        case SIMD_AVX2:   return "AVX2";
+        default:          return "Scalar";
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+// Набор векторных инструкций, под который выбираются горячие ядра.
+// Один бинарник идёт на разные машины, поэтому уровень определяется при запуске
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+// Что умеет процессор (cpuid с учётом поддержки регистров ОС)
+SimdLevel detectSimdLevel();
+
+// Уровень, с которым работает программа: определяется один раз. Переменная
+// окружения QUANTUM_SIMD=scalar|avx2|avx512 может только понизить его
+SimdLevel activeSimdLevel();
+
+const char* getSimdLevelName(SimdLevel level);
+
+#endif
@@ -1,7 +1,6 @@
 #ifndef QUANTUM_CORE_HPP
 #define QUANTUM_CORE_HPP
 
-#include <SFML/Graphics.hpp>
 #include <memory>
 #include <vector>
 #include <cmath>
@@ -17,6 +16,8 @@ public:
     double getY() const { return y; }
     double getZ() const { return z; }
     
+    double operator[](int axis) const { return axis == 0 ? x : (axis == 1 ? y : z); }
+    
     void setX(double v) { x = v; }
     void setY(double v) { y = v; }
     void setZ(double v) { z = v; }
@@ -81,6 +82,38 @@ public:
     }
 };
 
+// Линейная яркость в единицах 8-битного канала, без ограничения сверху.
+// Через всю рекурсию трассировки идёт она; в PhotonColor переводится один раз в конце
+struct PhotonRadiance {
+    float r, g, b;
+    
+    PhotonRadiance(float r = 0, float g = 0, float b = 0) : r(r), g(g), b(b) {}
+    explicit PhotonRadiance(const PhotonColor& color)
+        : r(static_cast<float>(color.getR())), g(static_cast<float>(color.getG())),
+          b(static_cast<float>(color.getB())) {}
+    
+    PhotonRadiance operator+(const PhotonRadiance& other) const {
+        return PhotonRadiance(r + other.r, g + other.g, b + other.b);
+    }
+    
+    PhotonRadiance operator*(float scale) const {
+        return PhotonRadiance(r * scale, g * scale, b * scale);
+    }
+    
+    PhotonRadiance blend(const PhotonRadiance& other, float ratio) const {
+        return *this * (1 - ratio) + other * ratio;
+    }
+    
+    PhotonColor toColor() const {
+        return PhotonColor(toChannel(r), toChannel(g), toChannel(b));
+    }
+    
+private:
+    static unsigned long toChannel(float value) {
+        return static_cast<unsigned long>(value < 0 ? 0.0f : (value > 255 ? 255.0f : value));
+    }
+};
+
 namespace NexusColors {
     const PhotonColor Void     (10 , 10 , 25 );
     const PhotonColor Nebula   (70 , 30 , 150);
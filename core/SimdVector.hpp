@@ -0,0 +1,228 @@
+#ifndef SIMD_VECTOR_HPP
+#define SIMD_VECTOR_HPP
+
+#include "QuantumCore.hpp"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Трёхмерный вектор для горячего пути трассировщика: хранится четырьмя
+// выровненными значениями (четвёртое всегда 0), чтобы операции шли одним
+// регистром. Порядок сложений в dot совпадает с QuantumVector, поэтому
+// результаты в double не отличаются от скалярных.
+template <typename T>
+class alignas(4 * sizeof(T)) SimdVector {
+private:
+    T v[4];
+
+public:
+    SimdVector(T x = 0, T y = 0, T z = 0) : v{x, y, z, 0} {}
+    explicit SimdVector(const QuantumVector& q)
+        : v{static_cast<T>(q.getX()), static_cast<T>(q.getY()), static_cast<T>(q.getZ()), 0} {}
+
+    T getX() const { return v[0]; }
+    T getY() const { return v[1]; }
+    T getZ() const { return v[2]; }
+    T operator[](int axis) const { return v[axis]; }
+
+    SimdVector operator+(const SimdVector& o) const { return SimdVector(v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2]); }
+    SimdVector operator-(const SimdVector& o) const { return SimdVector(v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2]); }
+    SimdVector operator*(T s) const { return SimdVector(v[0] * s, v[1] * s, v[2] * s); }
+
+    T dot(const SimdVector& o) const { return v[0] * o.v[0] + v[1] * o.v[1] + v[2] * o.v[2]; }
+
+    SimdVector cross(const SimdVector& o) const {
+        return SimdVector(v[1] * o.v[2] - v[2] * o.v[1],
+                          v[2] * o.v[0] - v[0] * o.v[2],
+                          v[0] * o.v[1] - v[1] * o.v[0]);
+    }
+
+    T length() const { return std::sqrt(dot(*this)); }
+
+    SimdVector normalize() const {
+        T len = length();
+        if (len == 0) return *this;
+        return SimdVector(v[0] / len, v[1] / len, v[2] / len);
+    }
+
+    QuantumVector toQuantum() const { return QuantumVector(v[0], v[1], v[2]); }
+};
+
+#if defined(__SSE2__)
+
+template <>
+class alignas(16) SimdVector<float> {
+private:
+    __m128 v;
+
+    explicit SimdVector(__m128 packed) : v(packed) {}
+
+    template <int Lane>
+    static float lane(__m128 packed) {
+        return _mm_cvtss_f32(_mm_shuffle_ps(packed, packed, _MM_SHUFFLE(Lane, Lane, Lane, Lane)));
+    }
+
+public:
+    SimdVector(float x = 0, float y = 0, float z = 0) : v(_mm_set_ps(0.0f, z, y, x)) {}
+    explicit SimdVector(const QuantumVector& q)
+        : v(_mm_set_ps(0.0f, static_cast<float>(q.getZ()), static_cast<float>(q.getY()),
+                       static_cast<float>(q.getX()))) {}
+
+    float getX() const { return _mm_cvtss_f32(v); }
+    float getY() const { return lane<1>(v); }
+    float getZ() const { return lane<2>(v); }
+    float operator[](int axis) const { return axis == 0 ? getX() : (axis == 1 ? getY() : getZ()); }
+
+    SimdVector operator+(const SimdVector& o) const { return SimdVector(_mm_add_ps(v, o.v)); }
+    SimdVector operator-(const SimdVector& o) const { return SimdVector(_mm_sub_ps(v, o.v)); }
+    SimdVector operator*(float s) const { return SimdVector(_mm_mul_ps(v, _mm_set1_ps(s))); }
+
+    float dot(const SimdVector& o) const {
+        __m128 p = _mm_mul_ps(v, o.v);
+        return (_mm_cvtss_f32(p) + lane<1>(p)) + lane<2>(p);
+    }
+
+    SimdVector cross(const SimdVector& o) const {
+        __m128 aYZX = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 aZXY = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 bYZX = _mm_shuffle_ps(o.v, o.v, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 bZXY = _mm_shuffle_ps(o.v, o.v, _MM_SHUFFLE(3, 1, 0, 2));
+        return SimdVector(_mm_sub_ps(_mm_mul_ps(aYZX, bZXY), _mm_mul_ps(aZXY, bYZX)));
+    }
+
+    float length() const { return std::sqrt(dot(*this)); }
+
+    SimdVector normalize() const {
+        float len = length();
+        if (len == 0) return *this;
+        return SimdVector(_mm_div_ps(v, _mm_set1_ps(len)));
+    }
+
+    QuantumVector toQuantum() const { return QuantumVector(getX(), getY(), getZ()); }
+};
+
+#endif
+
+#if defined(__AVX2__)
+
+template <>
+class alignas(32) SimdVector<double> {
+private:
+    __m256d v;
+
+    explicit SimdVector(__m256d packed) : v(packed) {}
+
+    template <int Lane>
+    static double lane(__m256d packed) {
+        return _mm256_cvtsd_f64(_mm256_permute4x64_pd(packed, _MM_SHUFFLE(Lane, Lane, Lane, Lane)));
+    }
+
+public:
+    SimdVector(double x = 0, double y = 0, double z = 0) : v(_mm256_set_pd(0.0, z, y, x)) {}
+    explicit SimdVector(const QuantumVector& q) : v(_mm256_set_pd(0.0, q.getZ(), q.getY(), q.getX())) {}
+
+    double getX() const { return _mm256_cvtsd_f64(v); }
+    double getY() const { return lane<1>(v); }
+    double getZ() const { return lane<2>(v); }
+    double operator[](int axis) const { return axis == 0 ? getX() : (axis == 1 ? getY() : getZ()); }
+
+    SimdVector operator+(const SimdVector& o) const { return SimdVector(_mm256_add_pd(v, o.v)); }
+    SimdVector operator-(const SimdVector& o) const { return SimdVector(_mm256_sub_pd(v, o.v)); }
+    SimdVector operator*(double s) const { return SimdVector(_mm256_mul_pd(v, _mm256_set1_pd(s))); }
+
+    double dot(const SimdVector& o) const {
+        __m256d p = _mm256_mul_pd(v, o.v);
+        return (_mm256_cvtsd_f64(p) + lane<1>(p)) + lane<2>(p);
+    }
+
+    SimdVector cross(const SimdVector& o) const {
+        __m256d aYZX = _mm256_permute4x64_pd(v, _MM_SHUFFLE(3, 0, 2, 1));
+        __m256d aZXY = _mm256_permute4x64_pd(v, _MM_SHUFFLE(3, 1, 0, 2));
+        __m256d bYZX = _mm256_permute4x64_pd(o.v, _MM_SHUFFLE(3, 0, 2, 1));
+        __m256d bZXY = _mm256_permute4x64_pd(o.v, _MM_SHUFFLE(3, 1, 0, 2));
+        return SimdVector(_mm256_sub_pd(_mm256_mul_pd(aYZX, bZXY), _mm256_mul_pd(aZXY, bYZX)));
+    }
+
+    double length() const { return std::sqrt(dot(*this)); }
+
+    SimdVector normalize() const {
+        double len = length();
+        if (len == 0) return *this;
+        return SimdVector(_mm256_div_pd(v, _mm256_set1_pd(len)));
+    }
+
+    QuantumVector toQuantum() const { return QuantumVector(getX(), getY(), getZ()); }
+};
+
+#elif defined(__SSE2__)
+
+// Без AVX2 (переносимая сборка под x86-64) - две половины SSE2: x,y и z,0
+template <>
+class alignas(32) SimdVector<double> {
+private:
+    __m128d xy;
+    __m128d zw;
+
+    SimdVector(__m128d xy, __m128d zw) : xy(xy), zw(zw) {}
+
+    static double high(__m128d packed) { return _mm_cvtsd_f64(_mm_unpackhi_pd(packed, packed)); }
+
+public:
+    SimdVector(double x = 0, double y = 0, double z = 0) : xy(_mm_set_pd(y, x)), zw(_mm_set_sd(z)) {}
+    explicit SimdVector(const QuantumVector& q) : xy(_mm_set_pd(q.getY(), q.getX())), zw(_mm_set_sd(q.getZ())) {}
+
+    double getX() const { return _mm_cvtsd_f64(xy); }
+    double getY() const { return high(xy); }
+    double getZ() const { return _mm_cvtsd_f64(zw); }
+    double operator[](int axis) const { return axis == 0 ? getX() : (axis == 1 ? getY() : getZ()); }
+
+    SimdVector operator+(const SimdVector& o) const { return SimdVector(_mm_add_pd(xy, o.xy), _mm_add_pd(zw, o.zw)); }
+    SimdVector operator-(const SimdVector& o) const { return SimdVector(_mm_sub_pd(xy, o.xy), _mm_sub_pd(zw, o.zw)); }
+    SimdVector operator*(double s) const {
+        __m128d scale = _mm_set1_pd(s);
+        return SimdVector(_mm_mul_pd(xy, scale), _mm_mul_pd(zw, scale));
+    }
+
+    double dot(const SimdVector& o) const {
+        __m128d p = _mm_mul_pd(xy, o.xy);
+        return (_mm_cvtsd_f64(p) + high(p)) + _mm_cvtsd_f64(_mm_mul_sd(zw, o.zw));
+    }
+
+    SimdVector cross(const SimdVector& o) const {
+        __m128d aYZ = _mm_shuffle_pd(xy, zw, 1);
+        __m128d aZX = _mm_shuffle_pd(zw, xy, 0);
+        __m128d bYZ = _mm_shuffle_pd(o.xy, o.zw, 1);
+        __m128d bZX = _mm_shuffle_pd(o.zw, o.xy, 0);
+        __m128d aYX = _mm_shuffle_pd(xy, xy, 1);
+        __m128d bYX = _mm_shuffle_pd(o.xy, o.xy, 1);
+        __m128d z = _mm_sub_sd(_mm_mul_sd(xy, bYX), _mm_mul_sd(aYX, o.xy));
+        return SimdVector(_mm_sub_pd(_mm_mul_pd(aYZ, bZX), _mm_mul_pd(aZX, bYZ)), _mm_move_sd(_mm_setzero_pd(), z));
+    }
+
+    double length() const { return std::sqrt(dot(*this)); }
+
+    SimdVector normalize() const {
+        double len = length();
+        if (len == 0) return *this;
+        __m128d scale = _mm_set1_pd(len);
+        return SimdVector(_mm_div_pd(xy, scale), _mm_div_pd(zw, scale));
+    }
+
+    QuantumVector toQuantum() const { return QuantumVector(getX(), getY(), getZ()); }
+};
+
+#endif
+
+// Точность геометрии трассировщика выбирается при сборке: float вдвое
+// расширяет векторные ядра и вдвое сокращает объём массивов сцены
+#ifdef QUANTUM_FLOAT_TRACER
+using TracerReal = float;
+#else
+using TracerReal = double;
+#endif
+
+using TracerVector = SimdVector<TracerReal>;
+
+#endif
@@ -0,0 +1,145 @@
+#include "WorkerPool.hpp"
+#include <algorithm>
+
+namespace {
+    // Пул и номер очереди текущего потока; -1 - поток не из пула
+    thread_local const WorkerPool* currentPool = nullptr;
+    thread_local int currentWorker = -1;
+}
+
+WorkerPool::WorkerPool(unsigned threadCount) {
+    threadCount = std::max(1u, threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    // Потоки стартуют после того, как все очереди созданы - воровать можно сразу у любой
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers[i]->thread = std::thread(&WorkerPool::workerLoop, this, static_cast<int>(i));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+void WorkerPool::submit(TaskGroup& group, std::function<void()> task) {
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+
+    int target = currentPool == this ? currentWorker
+                                     : static_cast<int>(nextWorker++ % workers.size());
+    {
+        std::lock_guard<std::mutex> lock(workers[target]->mutex);
+        workers[target]->tasks.push_back(Task{std::move(task), &group});
+    }
+    queued.fetch_add(1, std::memory_order_release);
+
+    // Через мьютекс сна: иначе поток, только что проверивший queued, уснёт мимо сигнала
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wake.notify_one();
+}
+
+void WorkerPool::wait(TaskGroup& group) {
+    if (currentPool == this) {
+        while (!group.isDone()) {
+            if (!runOne(currentWorker, &group)) {
+                std::this_thread::yield();
+            }
+        }
+    } else {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        groupDone.wait(lock, [&group] { return group.isDone(); });
+    }
+
+    std::lock_guard<std::mutex> lock(group.errorMutex);
+    if (group.error) {
+        std::exception_ptr error = group.error;
+        group.error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkerPool::workerLoop(int index) {
+    currentPool = this;
+    currentWorker = index;
+
+    while (true) {
+        if (runOne(index)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+    }
+}
+
+bool WorkerPool::runOne(int self, const TaskGroup* only) {
+    Task task;
+    if (!takeTask(self, only, task)) return false;
+
+    execute(task);
+    return true;
+}
+
+bool WorkerPool::takeTask(int self, const TaskGroup* only, Task& task) {
+    if (queued.load(std::memory_order_acquire) == 0) return false;
+
+    if (self >= 0) {
+        Worker& own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        for (auto it = own.tasks.end(); it != own.tasks.begin();) {
+            --it;
+            if (only && it->group != only) continue;
+            task = std::move(*it);
+            own.tasks.erase(it);
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Обход чужих очередей со сдвигом, чтобы воры не толпились у первой
+    int count = static_cast<int>(workers.size());
+    int start = self >= 0 ? self + 1 : static_cast<int>(nextWorker.load(std::memory_order_relaxed));
+    for (int i = 0; i < count; ++i) {
+        int victim = (start + i) % count;
+        if (victim == self) continue;
+
+        Worker& other = *workers[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        for (auto it = other.tasks.begin(); it != other.tasks.end(); ++it) {
+            if (only && it->group != only) continue;
+            task = std::move(*it);
+            other.tasks.erase(it);
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::execute(Task& task) {
+    TaskGroup* group = task.group;
+    try {
+        task.run();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(group->errorMutex);
+        if (!group->error) group->error = std::current_exception();
+    }
+    // Освобождаем захваченное задачей до того, как ждущий решит, что всё готово
+    task.run = nullptr;
+    // После последнего уменьшения группа может быть уже разрушена - трогаем только пул
+    if (group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        { std::lock_guard<std::mutex> lock(doneMutex); }
+        groupDone.notify_all();
+    }
+}
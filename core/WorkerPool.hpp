@@ -0,0 +1,83 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Постоянные потоки на всю программу вместо std::async на каждую задачу.
+// У каждого потока своя очередь: свои задачи он берёт с конца (свежие данные
+// ещё в кэше), а освободившись, забирает самые старые из чужих очередей.
+// Так мелкие задачи сами распределяются между потоками без общей блокировки
+class WorkerPool {
+public:
+    // Задачи, окончания которых ждут вместе. Исключение первой упавшей
+    // задачи пробрасывается из wait
+    class TaskGroup {
+    private:
+        friend class WorkerPool;
+        std::atomic<int> pending{0};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+    public:
+        TaskGroup() = default;
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    explicit WorkerPool(unsigned threadCount);
+    ~WorkerPool();
+
+    // Общий пул по числу аппаратных потоков
+    static WorkerPool& shared();
+
+    unsigned getWorkerCount() const { return static_cast<unsigned>(workers.size()); }
+
+    // Из рабочего потока задача кладётся в его же очередь, снаружи - по кругу
+    void submit(TaskGroup& group, std::function<void()> task);
+    // Рабочий поток, пока группа не закончена, сам выполняет её задачи -
+    // вложенное ожидание внутри задачи не занимает поток впустую. Чужие
+    // задачи он не берёт: они могут читать то, что сейчас строит ждущий.
+    // Поток не из пула просто спит до окончания группы
+    void wait(TaskGroup& group);
+
+private:
+    struct Task {
+        std::function<void()> run;
+        TaskGroup* group;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> queued{0};
+    std::atomic<unsigned> nextWorker{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    // Будит потоки не из пула, ждущие окончания группы
+    std::mutex doneMutex;
+    std::condition_variable groupDone;
+
+    void workerLoop(int index);
+    // Берёт задачу из своей очереди или крадёт чужую; only - только задачи
+    // этой группы. false - брать нечего
+    bool runOne(int self, const TaskGroup* only = nullptr);
+    bool takeTask(int self, const TaskGroup* only, Task& task);
+    void execute(Task& task);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "NexusPanel.hpp"
 #include "../system/RenderEngine.hpp"
 #include "../rendering/PhotonTracer.hpp"
+#include "../core/CpuFeatures.hpp"
 #include <iostream>
 #include <cstdlib>
 
@@ -336,10 +337,9 @@ void ControlNexus::createInterface() {
             double reflectivity  = (std::rand() % 100) / 100.0;
             double transparency  = (std::rand() % 50 ) / 100.0;
             
-            auto sphere = std::make_unique<CrystalSphere>(
+            rayTracer->emplaceObject<CrystalSphere>(
                 QuantumVector(x, y, z), r, randomColor, reflectivity, transparency
             );
-            rayTracer->addObject(std::move(sphere));
             if (onObjectsChanged) onObjectsChanged();
         }
     );
@@ -368,14 +368,13 @@ void ControlNexus::createInterface() {
             double reflectivity  = (std::rand() % 100) / 100.0;
             double transparency  = (std::rand() % 30 ) / 100.0;
             
-            auto pyramid = std::make_unique<Pyramid>(
+            rayTracer->emplaceObject<Pyramid>(
                 QuantumVector(x, y, z), 
                 QuantumVector(dirX, dirY, dirZ),
 
                 baseRadius, sides, randomColor, reflectivity, transparency
             );
 
-            rayTracer->addObject(std::move(pyramid));
             if (onObjectsChanged) onObjectsChanged();
         }
     );
@@ -399,12 +398,11 @@ void ControlNexus::createInterface() {
             
             double intensity = (std::rand() % 100) / 100.0 + 0.5;
             
-            auto light = std::make_unique<CrystalSphere>(
+            rayTracer->emplaceObject<CrystalSphere>(
                 QuantumVector(x, y, z), 0.4, lightColor,
                 0.0, 0.0, 1.0, 1.0, OBJECT_LIGHT_SOURCE, intensity
             );
 
-            rayTracer->addObject(std::move(light));
             if (onObjectsChanged) onObjectsChanged();
         }
     );
@@ -430,7 +428,8 @@ void ControlNexus::createInterface() {
             double reflectivity  = (std::rand() % 100) / 100.0;
             double transparency  = (std::rand() % 30 ) / 100.0;
             
-            auto plane = std::make_unique<FinitePlane>(
+            auto plane = FinitePlane::create(
+                rayTracer->getSceneArena(),
                 QuantumVector(x, y, z),
                 QuantumVector(0, 1, 0),
                 QuantumVector(1, 0, 0),
@@ -442,9 +441,39 @@ void ControlNexus::createInterface() {
     );
     addChild(std::move(addPlaneBtn));
     
-    auto removeObjectBtn = std::make_unique<QuantumButton>(
+    auto addBoxBtn = std::make_unique<QuantumButton>(
         QuantumVector(20, startY + 4*(buttonHeight + spacing), 0),
         QuantumVector(buttonWidth, buttonHeight, 0),
+        "Add Box", [this]() {
+            double x = (std::rand() % 100) / 10.0 - 5.0;
+            double y = (std::rand() % 100) / 10.0 - 3.0;
+            double z = (std::rand() % 100) / 10.0 + 5.0;
+            
+            PhotonColor randomColor(
+                std::rand() % 256,
+                std::rand() % 256, 
+                std::rand() % 256
+            );
+            
+            double sizeX         = (std::rand() % 30 ) / 10.0 + 0.5;
+            double sizeY         = (std::rand() % 30 ) / 10.0 + 0.5;
+            double sizeZ         = (std::rand() % 30 ) / 10.0 + 0.5;
+            double reflectivity  = (std::rand() % 100) / 100.0;
+            double transparency  = (std::rand() % 30 ) / 100.0;
+            
+            rayTracer->emplaceObject<Box>(
+                QuantumVector(x, y, z),
+                QuantumVector(sizeX, sizeY, sizeZ),
+                randomColor, reflectivity, transparency
+            );
+            if (onObjectsChanged) onObjectsChanged();
+        }
+    );
+    addChild(std::move(addBoxBtn));
+    
+    auto removeObjectBtn = std::make_unique<QuantumButton>(
+        QuantumVector(20, startY + 5*(buttonHeight + spacing), 0),
+        QuantumVector(buttonWidth, buttonHeight, 0),
         "Remove Object", [this]() {
             rayTracer->removeLastObject();
             if (onObjectsChanged) onObjectsChanged();
@@ -453,7 +482,7 @@ void ControlNexus::createInterface() {
     addChild(std::move(removeObjectBtn));
     
     auto removeLightBtn = std::make_unique<QuantumButton>(
-        QuantumVector(20, startY + 5*(buttonHeight + spacing), 0),
+        QuantumVector(20, startY + 6*(buttonHeight + spacing), 0),
         QuantumVector(buttonWidth, buttonHeight, 0),
         "Remove Light", [this]() {
             rayTracer->removeLastLightSource();
@@ -461,6 +490,19 @@ void ControlNexus::createInterface() {
         }
     );
     addChild(std::move(removeLightBtn));
+    
+    auto acceleratorBtn = std::make_unique<QuantumButton>(
+        QuantumVector(20, startY + 7*(buttonHeight + spacing), 0),
+        QuantumVector(buttonWidth, buttonHeight, 0),
+        "Switch Accelerator", [this]() {
+            switch (rayTracer->getAccelerationMode()) {
+                case ACCELERATION_AUTO:      rayTracer->setAccelerationMode(ACCELERATION_HIERARCHY); break;
+                case ACCELERATION_HIERARCHY: rayTracer->setAccelerationMode(ACCELERATION_GRID);      break;
+                case ACCELERATION_GRID:      rayTracer->setAccelerationMode(ACCELERATION_AUTO);      break;
+            }
+        }
+    );
+    addChild(std::move(acceleratorBtn));
 }
 
 InfoNexus::InfoNexus(const QuantumVector& pos, const QuantumVector& size, RayTracer* tracer)
@@ -492,6 +534,33 @@ void InfoNexus::render(RenderEngine& engine) {
     
     std::string fpsText = "FPS: " + std::to_string(static_cast<int>(currentFPS));
     engine.drawText(x, y, fpsText, NexusColors::Light, 14);
+    y += lineHeight;
+    
+    std::string acceleratorText = "Accel: ";
+    if (rayTracer->getActiveAccelerator() == ACCELERATION_GRID) {
+        acceleratorText += "Grid";
+    } else {
+        acceleratorText += rayTracer->isCompactHierarchy() ? "BVH4q" : "BVH";
+    }
+    if (rayTracer->getAccelerationMode() == ACCELERATION_AUTO) {
+        acceleratorText += " (auto)";
+    }
+    engine.drawText(x, y, acceleratorText, NexusColors::Light, 14);
+    y += lineHeight;
+    
+    std::string simdText = "SIMD: " + std::string(getSimdLevelName(activeSimdLevel())) +
+                           " x" + std::to_string(SphereKernel::laneCount());
+    engine.drawText(x, y, simdText, NexusColors::Light, 14);
+    y += lineHeight;
+    
+    std::string buildText = "Build: " + std::to_string(static_cast<int>(rayTracer->getLastBuildTime())) + " ms";
+    engine.drawText(x, y, buildText, NexusColors::Light, 14);
+    y += lineHeight;
+    
+    std::string memoryText = "Accel mem: " +
+                             std::to_string(static_cast<int>(rayTracer->getAccelerationBytesPerObject())) + " B/obj (peak " +
+                             std::to_string(static_cast<int>(rayTracer->getPeakBuildBytesPerObject())) + ")";
+    engine.drawText(x, y, memoryText, NexusColors::Light, 14);
 }
 
 void InfoNexus::update(float delta) {
@@ -70,7 +70,8 @@ ObjectTypeList::ObjectTypeList(const QuantumVector& pos, const QuantumVector& si
         {"Pyramids", 0, false},
         {"Spheres", 0, false},
         {"LightSources", 0, false},
-        {"Planes", 0, false}
+        {"Planes", 0, false},
+        {"Boxes", 0, false}
     };
 }
 
@@ -345,7 +346,8 @@ void ObjectDetailsPanel::clearObjects() {
 
 ObjectListPanel::ObjectListPanel(const QuantumVector& pos, const QuantumVector& size, RayTracer* tracer)
     : CosmicContainer(pos, size), rayTracer(tracer), currentExpandedType(""),
-      pyramidDetails(nullptr), sphereDetails(nullptr), lightDetails(nullptr), planeDetails(nullptr) {
+      pyramidDetails(nullptr), sphereDetails(nullptr), lightDetails(nullptr), planeDetails(nullptr),
+      boxDetails(nullptr) {
     
     auto arrowBtn = std::make_unique<DropdownArrow>(
         QuantumVector(0, 0, 0), 
@@ -407,6 +409,14 @@ void ObjectListPanel::createDetailPanels() {
     planeDetails = planePanel.get();
     planeDetails->setVisible(false);
     addChild(std::move(planePanel));
+    
+    auto boxPanel = std::make_unique<ObjectDetailsPanel>(
+        QuantumVector(0, 160, 0),
+        QuantumVector(450, 280, 0)
+    );
+    boxDetails = boxPanel.get();
+    boxDetails->setVisible(false);
+    addChild(std::move(boxPanel));
 }
 
 void ObjectListPanel::showDetailPanel(const std::string& type) {
@@ -427,6 +437,9 @@ void ObjectListPanel::showDetailPanel(const std::string& type) {
     else if (type == "Planes" && planeDetails) {
         planeDetails->setVisible(true);
     }
+    else if (type == "Boxes" && boxDetails) {
+        boxDetails->setVisible(true);
+    }
 }
 
 void ObjectListPanel::hideDetailPanels() {
@@ -434,6 +447,7 @@ void ObjectListPanel::hideDetailPanels() {
     if (sphereDetails) sphereDetails->setVisible(false);
     if (lightDetails) lightDetails->setVisible(false);
     if (planeDetails) planeDetails->setVisible(false);
+    if (boxDetails) boxDetails->setVisible(false);
     currentExpandedType = "";
 }
 
@@ -454,6 +468,9 @@ void ObjectListPanel::updateObjectDetails() {
     else if (currentExpandedType == "Planes" && planeDetails) {
         planeDetails->setObjectInfos(objectInfos);
     }
+    else if (currentExpandedType == "Boxes" && boxDetails) {
+        boxDetails->setObjectInfos(objectInfos);
+    }
 }
 
 std::vector<std::string> ObjectListPanel::getObjectInfosByType(const std::string& type) const {
@@ -102,6 +102,7 @@ private:
     ObjectDetailsPanel* sphereDetails;
     ObjectDetailsPanel* lightDetails;
     ObjectDetailsPanel* planeDetails;
+    ObjectDetailsPanel* boxDetails;
 
 public:
     ObjectListPanel(const QuantumVector& pos, const QuantumVector& size, RayTracer* tracer);
@@ -4,6 +4,7 @@
 #include "interface/ObjectListPanel.hpp"
 #include "rendering/CosmicView.hpp"
 #include "rendering/PhotonTracer.hpp"
+#include "core/CpuFeatures.hpp"
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -15,6 +16,10 @@ int main() {
     try {
         RenderEngine engine(WINDOW_WIDTH, WINDOW_HEIGHT, "Quantum Nexus - Refraction Demo");
         
+        std::cout << "Tracing kernels: " << getSimdLevelName(activeSimdLevel())
+                  << " (" << SphereKernel::laneCount() << " lanes, CPU supports "
+                  << getSimdLevelName(detectSimdLevel()) << ")" << std::endl;
+        
         auto photonTracer = std::make_unique<RayTracer>();
         auto observerController = std::make_unique<ObserverController>(QuantumVector(0, 2, -8));
         
@@ -29,6 +34,7 @@ int main() {
             QuantumVector(300, 50, 0), QuantumVector(1000, 700, 0),
             *photonTracer, *observerController
         );
+        CosmicView* cosmicViewPtr = cosmicView.get();
         
         auto objectListPanel = std::make_unique<ObjectListPanel>(
             QuantumVector(1325, 370, 0), QuantumVector(150, 30, 0),
@@ -42,28 +48,27 @@ int main() {
         );
         
         auto infoPanel = std::make_unique<InfoNexus>(
-            QuantumVector(20, 520, 0), QuantumVector(250, 230, 0), photonTracer.get()
+            QuantumVector(20, 520, 0), QuantumVector(250, 250, 0), photonTracer.get()
         );
         InfoNexus* infoPanelPtr = infoPanel.get();
         
         auto cameraPanel = std::make_unique<CameraControlsPanel>(
             QuantumVector(1325, 50, 0), QuantumVector(250, 300, 0), 
-            [&observerController, &photonTracer](int key) { 
-                observerController->handleKey(key);
-                photonTracer->setObserverPosition(observerController->getPosition());
-                photonTracer->setObserverDirection(observerController->getDirection());
+            [cosmicViewPtr](int key) { 
+                // Через вид: камера сдвигается вместе с прерыванием текущего кадра
+                cosmicViewPtr->moveObserver(key);
             }
         );
 
         auto updateObjectStats = [photonTracer = photonTracer.get(), objectListPanelPtr]() {
             if (photonTracer && objectListPanelPtr) {
-                photonTracer->updateObjectStatistics();
-                std::vector<std::string> types = {"Pyramids", "Spheres", "LightSources", "Planes"};
+                std::vector<std::string> types = {"Pyramids", "Spheres", "LightSources", "Planes", "Boxes"};
                 std::vector<int> counts = {
                     photonTracer->getPyramidCount(),
                     photonTracer->getSphereCount(), 
                     photonTracer->getLightSourceCount(),
-                    photonTracer->getPlaneCount()
+                    photonTracer->getPlaneCount(),
+                    photonTracer->getBoxCount()
                 };
                 objectListPanelPtr->updateObjectCounts(types, counts);
             }
@@ -78,28 +83,29 @@ int main() {
         root->addChild(std::move(objectListPanel));
 
         // Яркий источник света
-        photonTracer->addObject(std::make_unique<CrystalSphere>(
+        photonTracer->emplaceObject<CrystalSphere>(
             QuantumVector(0, 10, 5), 1.0, PhotonColor(255, 255, 220),
             0.0, 0.0, 1.0, 1.0, OBJECT_LIGHT_SOURCE, 3.0
-        ));
+        );
         
         // Пол
-        photonTracer->addObject(std::make_unique<FinitePlane>(
+        photonTracer->addObject(FinitePlane::create(
+            photonTracer->getSceneArena(),
             QuantumVector(0, -2, 0), QuantumVector(0, 1, 0), QuantumVector(1, 0, 0),
             50.0, 50.0, PhotonColor(100, 100, 100), 0.1, 0.0, 1.0, 32.0
         ));
 
         // Преломляющая сфера (стекло)
-        photonTracer->addObject(std::make_unique<CrystalSphere>(
+        photonTracer->emplaceObject<CrystalSphere>(
             QuantumVector(0, 0, 10), 1.5, PhotonColor(200, 200, 255),
             0.05, 0.9, 1.5, 128.0
-        ));
+        );
 
-        // Кубик сзади сферы (4 пирамиды как куб)
-        photonTracer->addObject(std::make_unique<Pyramid>(
-            QuantumVector(0, 0, 16), QuantumVector(0, 1, 0), 1.0, 4,
+        // Кубик сзади сферы
+        photonTracer->emplaceObject<Box>(
+            QuantumVector(0, 0.5, 16), QuantumVector(1.4, 1.4, 1.4),
             PhotonColor(255, 100, 100), 0.8, 0.0, 1.0, 64.0
-        ));
+        );
 
         updateObjectStats();
 
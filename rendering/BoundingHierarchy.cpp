@@ -0,0 +1,499 @@
+#include "BoundingHierarchy.hpp"
+#include "../core/WorkerPool.hpp"
+#include <utility>
+
+void BoundingHierarchy::clear() {
+    nodes.clear();
+    freeNodes.clear();
+    leafOfPrimitive.clear();
+    root = -1;
+    internalArea = 0.0;
+    referenceCost = 0.0;
+}
+
+namespace {
+    // Порог, начиная с которого проходы по диапазону (границы, бины) делятся на части
+    const int PARALLEL_SCAN_GRAIN = 65536;
+    const int SAH_BINS = 16;
+
+    struct SahBins {
+        BoundingBox bounds[SAH_BINS];
+        int counts[SAH_BINS] = {0};
+    };
+
+    template <typename Partial, typename Scan, typename Combine>
+    Partial parallelScan(int begin, int end, int chunks, Scan scan, Combine combine) {
+        if (chunks <= 1 || end - begin < PARALLEL_SCAN_GRAIN) {
+            return scan(begin, end);
+        }
+        
+        int step = (end - begin + chunks - 1) / chunks;
+        std::vector<Partial> parts((end - begin - 1) / step);
+        WorkerPool& pool = WorkerPool::shared();
+        WorkerPool::TaskGroup group;
+        for (size_t part = 0; part < parts.size(); ++part) {
+            int from = begin + static_cast<int>(part + 1) * step;
+            int to = std::min(end, from + step);
+            pool.submit(group, [&parts, &scan, part, from, to]() { parts[part] = scan(from, to); });
+        }
+        
+        Partial result = scan(begin, std::min(end, begin + step));
+        pool.wait(group);
+        for (const auto& part : parts) {
+            combine(result, part);
+        }
+        return result;
+    }
+}
+
+int SahBuilder::spawnDepth() {
+    unsigned threads = WorkerPool::shared().getWorkerCount();
+    int depth = 0;
+    while ((1u << depth) < threads * 4) depth++;
+    return depth;
+}
+
+void SahBuilder::prepare(const std::vector<BoundingBox>& primitiveBounds, std::vector<int>& order) {
+    int count = static_cast<int>(primitiveBounds.size());
+    order.resize(count);
+    
+    int chunks = static_cast<int>(WorkerPool::shared().getWorkerCount());
+    parallelScan<int>(0, count, chunks, [&](int from, int to) {
+        for (int i = from; i < to; ++i) {
+            order[i] = i;
+        }
+        return 0;
+    }, [](int&, int) {});
+}
+
+BoundingBox SahBuilder::rangeBounds(const std::vector<int>& order, const std::vector<BoundingBox>& primitiveBounds,
+                                    int begin, int end, int chunks) {
+    return parallelScan<BoundingBox>(begin, end, chunks, [&](int from, int to) {
+        BoundingBox partial;
+        for (int i = from; i < to; ++i) {
+            partial.merge(primitiveBounds[order[i]]);
+        }
+        return partial;
+    }, [](BoundingBox& total, const BoundingBox& partial) {
+        total.merge(partial);
+    });
+}
+
+int SahBuilder::split(std::vector<int>& order, const std::vector<BoundingBox>& primitiveBounds, int begin, int end,
+                      int chunks, BoundingBox& rangeBounds) {
+    using BoundsPair = std::pair<BoundingBox, BoundingBox>;
+    BoundsPair scanned = parallelScan<BoundsPair>(begin, end, chunks, [&](int from, int to) {
+        BoundsPair partial;
+        for (int i = from; i < to; ++i) {
+            partial.first.merge(primitiveBounds[order[i]]);
+            partial.second.expand(primitiveBounds[order[i]].getCenter());
+        }
+        return partial;
+    }, [](BoundsPair& total, const BoundsPair& partial) {
+        total.first.merge(partial.first);
+        total.second.merge(partial.second);
+    });
+
+    const BoundingBox& centroidBounds = scanned.second;
+    rangeBounds = scanned.first;
+
+    QuantumVector extent = centroidBounds.maxCorner - centroidBounds.minCorner;
+    int axis = 0;
+    if (extent.getY() > extent[axis]) axis = 1;
+    if (extent.getZ() > extent[axis]) axis = 2;
+
+    int mid = begin + (end - begin) / 2;
+    auto centroidOf = [&](int primitive) {
+        const BoundingBox& bounds = primitiveBounds[primitive];
+        return (bounds.minCorner[axis] + bounds.maxCorner[axis]) * 0.5;
+    };
+
+    if (extent[axis] > 1e-12) {
+        double axisMin = centroidBounds.minCorner[axis];
+        double scale = SAH_BINS / extent[axis];
+
+        auto binOf = [&](int primitive) {
+            int bin = static_cast<int>((centroidOf(primitive) - axisMin) * scale);
+            return std::min(bin, SAH_BINS - 1);
+        };
+
+        SahBins bins = parallelScan<SahBins>(begin, end, chunks, [&](int from, int to) {
+            SahBins partial;
+            for (int i = from; i < to; ++i) {
+                int bin = binOf(order[i]);
+                partial.counts[bin]++;
+                partial.bounds[bin].merge(primitiveBounds[order[i]]);
+            }
+            return partial;
+        }, [](SahBins& total, const SahBins& partial) {
+            for (int b = 0; b < SAH_BINS; ++b) {
+                total.counts[b] += partial.counts[b];
+                total.bounds[b].merge(partial.bounds[b]);
+            }
+        });
+
+        // Площади префиксов справа, чтобы оценить все разрезы за один проход
+        double rightArea[SAH_BINS];
+        int rightCount[SAH_BINS];
+        BoundingBox accumulated;
+        int accumulatedCount = 0;
+        for (int b = SAH_BINS - 1; b > 0; --b) {
+            accumulated.merge(bins.bounds[b]);
+            accumulatedCount += bins.counts[b];
+            rightArea[b] = accumulated.surfaceArea();
+            rightCount[b] = accumulatedCount;
+        }
+
+        double bestCost = std::numeric_limits<double>::infinity();
+        int bestSplit = -1;
+        accumulated = BoundingBox();
+        accumulatedCount = 0;
+        for (int b = 1; b < SAH_BINS; ++b) {
+            accumulated.merge(bins.bounds[b - 1]);
+            accumulatedCount += bins.counts[b - 1];
+            if (accumulatedCount == 0 || rightCount[b] == 0) continue;
+
+            double cost = accumulated.surfaceArea() * accumulatedCount + rightArea[b] * rightCount[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        if (bestSplit > 0) {
+            auto pivot = std::partition(order.begin() + begin, order.begin() + end,
+                                        [&](int primitive) { return binOf(primitive) < bestSplit; });
+            mid = static_cast<int>(pivot - order.begin());
+        }
+    }
+
+    if (mid == begin || mid == end) {
+        mid = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](int a, int b) { return centroidOf(a) < centroidOf(b); });
+    }
+
+    return mid;
+}
+
+void BoundingHierarchy::build(const std::vector<BoundingBox>& primitiveBounds, BuildMemoryMeter* meter) {
+    clear();
+
+    int count = static_cast<int>(primitiveBounds.size());
+    if (count == 0) return;
+
+    std::vector<int> order;
+    SahBuilder::prepare(primitiveBounds, order);
+    size_t scratchBytes = order.capacity() * sizeof(int);
+
+    // Бинарное дерево с листом на примитив содержит ровно 2n-1 узлов, а поддерево
+    // из k примитивов - ровно 2k-1, поэтому задачи пишут в заранее известные
+    // непересекающиеся диапазоны узлов и не нуждаются в синхронизации
+    nodes.resize(2 * count - 1);
+    leafOfPrimitive.assign(count, -1);
+    if (meter) {
+        meter->allocate(scratchBytes + getMemoryUsage());
+    }
+    root = buildRange(order, primitiveBounds, 0, count, 0, -1, SahBuilder::spawnDepth());
+    
+    internalArea = 0.0;
+    for (const auto& node : nodes) {
+        if (!node.isLeaf()) internalArea += node.bounds.surfaceArea();
+    }
+    referenceCost = currentCost();
+    
+    if (meter) {
+        meter->release(scratchBytes);
+    }
+}
+
+int BoundingHierarchy::buildRange(std::vector<int>& order, const std::vector<BoundingBox>& primitiveBounds,
+                                  int begin, int end, int nodeIndex, int parent, int spawnDepth) {
+    HierarchyNode& node = nodes[nodeIndex];
+    node.parent = parent;
+
+    if (end - begin == 1) {
+        node.primitive = order[begin];
+        node.bounds = primitiveBounds[order[begin]];
+        node.left = node.right = -1;
+        node.height = 0;
+        leafOfPrimitive[order[begin]] = nodeIndex;
+        return nodeIndex;
+    }
+
+    int chunks = spawnDepth > 0 ? (1 << std::min(spawnDepth, 5)) : 1;
+    int mid = SahBuilder::split(order, primitiveBounds, begin, end, chunks, node.bounds);
+    node.primitive = -1;
+
+    int leftCount = mid - begin;
+    int leftIndex = nodeIndex + 1;
+    int rightIndex = nodeIndex + 2 * leftCount;
+
+    if (spawnDepth > 0 && end - begin > SahBuilder::PARALLEL_SUBTREE_GRAIN) {
+        WorkerPool& pool = WorkerPool::shared();
+        WorkerPool::TaskGroup left;
+        pool.submit(left, [&]() {
+            buildRange(order, primitiveBounds, begin, mid, leftIndex, nodeIndex, spawnDepth - 1);
+        });
+        buildRange(order, primitiveBounds, mid, end, rightIndex, nodeIndex, spawnDepth - 1);
+        pool.wait(left);
+    } else {
+        buildRange(order, primitiveBounds, begin, mid, leftIndex, nodeIndex, 0);
+        buildRange(order, primitiveBounds, mid, end, rightIndex, nodeIndex, 0);
+    }
+
+    nodes[nodeIndex].left = leftIndex;
+    nodes[nodeIndex].right = rightIndex;
+    nodes[nodeIndex].height = 1 + std::max(nodes[leftIndex].height, nodes[rightIndex].height);
+    return nodeIndex;
+}
+
+double BoundingHierarchy::currentCost() const {
+    if (root < 0) return 0.0;
+    double rootArea = nodes[root].bounds.surfaceArea();
+    return rootArea > 0.0 ? internalArea / rootArea : 0.0;
+}
+
+double BoundingHierarchy::getQualityRatio() const {
+    if (referenceCost <= 0.0) return 1.0;
+    return currentCost() / referenceCost;
+}
+
+int BoundingHierarchy::allocateNode() {
+    if (!freeNodes.empty()) {
+        int index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = HierarchyNode();
+        return index;
+    }
+    nodes.emplace_back();
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+void BoundingHierarchy::freeNode(int index) {
+    if (!nodes[index].isLeaf()) {
+        internalArea -= nodes[index].bounds.surfaceArea();
+    }
+    nodes[index] = HierarchyNode();
+    nodes[index].height = -1;
+    freeNodes.push_back(index);
+}
+
+void BoundingHierarchy::setInternalBounds(int index, const BoundingBox& bounds) {
+    internalArea += bounds.surfaceArea() - nodes[index].bounds.surfaceArea();
+    nodes[index].bounds = bounds;
+}
+
+int BoundingHierarchy::findBestSibling(const BoundingBox& bounds) const {
+    int index = root;
+    
+    // Спуск как в динамическом дереве Box2D: на каждом уровне сравниваем стоимость
+    // нового родителя здесь с нижней оценкой стоимости спуска в каждого из детей
+    while (!nodes[index].isLeaf()) {
+        const HierarchyNode& node = nodes[index];
+        
+        BoundingBox combined = node.bounds;
+        combined.merge(bounds);
+        double area = node.bounds.surfaceArea();
+        double combinedArea = combined.surfaceArea();
+        
+        double cost = 2.0 * combinedArea;
+        double inheritanceCost = 2.0 * (combinedArea - area);
+        
+        auto descendCost = [&](int child) {
+            BoundingBox merged = nodes[child].bounds;
+            merged.merge(bounds);
+            if (nodes[child].isLeaf()) {
+                return merged.surfaceArea() + inheritanceCost;
+            }
+            return merged.surfaceArea() - nodes[child].bounds.surfaceArea() + inheritanceCost;
+        };
+        
+        double costLeft = descendCost(node.left);
+        double costRight = descendCost(node.right);
+        
+        if (cost < costLeft && cost < costRight) break;
+        
+        index = costLeft < costRight ? node.left : node.right;
+    }
+    
+    return index;
+}
+
+void BoundingHierarchy::insert(int primitive, const BoundingBox& bounds) {
+    if (primitive >= static_cast<int>(leafOfPrimitive.size())) {
+        leafOfPrimitive.resize(primitive + 1, -1);
+    }
+    
+    int leaf = allocateNode();
+    nodes[leaf].bounds = bounds;
+    nodes[leaf].primitive = primitive;
+    nodes[leaf].height = 0;
+    leafOfPrimitive[primitive] = leaf;
+    
+    if (root < 0) {
+        root = leaf;
+        return;
+    }
+    
+    int sibling = findBestSibling(bounds);
+    int oldParent = nodes[sibling].parent;
+    
+    int newParent = allocateNode();
+    BoundingBox combined = nodes[sibling].bounds;
+    combined.merge(bounds);
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].bounds = combined;
+    internalArea += combined.surfaceArea();
+    
+    if (oldParent < 0) {
+        root = newParent;
+    } else if (nodes[oldParent].left == sibling) {
+        nodes[oldParent].left = newParent;
+    } else {
+        nodes[oldParent].right = newParent;
+    }
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    
+    refitFrom(oldParent);
+    
+    if (referenceCost <= 0.0) {
+        referenceCost = currentCost();
+    }
+}
+
+void BoundingHierarchy::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = -1;
+        freeNode(leaf);
+        return;
+    }
+    
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+    
+    if (grandParent < 0) {
+        root = sibling;
+        nodes[sibling].parent = -1;
+    } else {
+        if (nodes[grandParent].left == parent) {
+            nodes[grandParent].left = sibling;
+        } else {
+            nodes[grandParent].right = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+    }
+    
+    freeNode(parent);
+    freeNode(leaf);
+    refitFrom(grandParent);
+}
+
+void BoundingHierarchy::remove(int primitive) {
+    if (primitive < 0 || primitive >= static_cast<int>(leafOfPrimitive.size())) return;
+    
+    int leaf = leafOfPrimitive[primitive];
+    if (leaf < 0) return;
+    
+    removeLeaf(leaf);
+    leafOfPrimitive[primitive] = -1;
+    
+    while (!leafOfPrimitive.empty() && leafOfPrimitive.back() < 0) {
+        leafOfPrimitive.pop_back();
+    }
+}
+
+void BoundingHierarchy::renumber(int from, int to) {
+    if (!contains(from)) return;
+    
+    if (to >= static_cast<int>(leafOfPrimitive.size())) {
+        leafOfPrimitive.resize(to + 1, -1);
+    }
+    int leaf = leafOfPrimitive[from];
+    nodes[leaf].primitive = to;
+    leafOfPrimitive[to] = leaf;
+    leafOfPrimitive[from] = -1;
+    
+    while (!leafOfPrimitive.empty() && leafOfPrimitive.back() < 0) {
+        leafOfPrimitive.pop_back();
+    }
+}
+
+void BoundingHierarchy::refitFrom(int index) {
+    while (index >= 0) {
+        index = balance(index);
+        
+        HierarchyNode& node = nodes[index];
+        BoundingBox bounds = nodes[node.left].bounds;
+        bounds.merge(nodes[node.right].bounds);
+        setInternalBounds(index, bounds);
+        node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+        
+        index = node.parent;
+    }
+}
+
+// Локальная перестройка: AVL-поворот, если поддеревья узла разбалансированы по высоте
+int BoundingHierarchy::balance(int indexA) {
+    HierarchyNode& a = nodes[indexA];
+    if (a.isLeaf() || a.height < 2) return indexA;
+    
+    int indexB = a.left;
+    int indexC = a.right;
+    int difference = nodes[indexC].height - nodes[indexB].height;
+    
+    if (difference > 1) {
+        std::swap(indexB, indexC);
+    } else if (difference >= -1) {
+        return indexA;
+    }
+    
+    // indexB - более высокое поддерево, поднимаем его на место A
+    HierarchyNode& b = nodes[indexB];
+    int indexF = b.left;
+    int indexG = b.right;
+    
+    b.parent = a.parent;
+    if (b.parent >= 0) {
+        if (nodes[b.parent].left == indexA) {
+            nodes[b.parent].left = indexB;
+        } else {
+            nodes[b.parent].right = indexB;
+        }
+    } else {
+        root = indexB;
+    }
+    
+    if (nodes[indexF].height < nodes[indexG].height) {
+        std::swap(indexF, indexG);
+    }
+    
+    // F остаётся под B, G уходит к A на место B
+    b.left = indexA;
+    b.right = indexF;
+    a.parent = indexB;
+    nodes[indexF].parent = indexB;
+    nodes[indexG].parent = indexA;
+    if (a.left == indexB) {
+        a.left = indexG;
+    } else {
+        a.right = indexG;
+    }
+    
+    BoundingBox boundsA = nodes[a.left].bounds;
+    boundsA.merge(nodes[a.right].bounds);
+    setInternalBounds(indexA, boundsA);
+    a.height = 1 + std::max(nodes[a.left].height, nodes[a.right].height);
+    
+    BoundingBox boundsB = nodes[b.left].bounds;
+    boundsB.merge(nodes[b.right].bounds);
+    setInternalBounds(indexB, boundsB);
+    b.height = 1 + std::max(nodes[b.left].height, nodes[b.right].height);
+    
+    return indexB;
+}
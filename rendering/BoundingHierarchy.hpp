@@ -0,0 +1,328 @@
+#ifndef BOUNDING_HIERARCHY_HPP
+#define BOUNDING_HIERARCHY_HPP
+
+#include "../core/QuantumCore.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+struct BoundingBox {
+    QuantumVector minCorner;
+    QuantumVector maxCorner;
+
+    BoundingBox()
+        : minCorner( std::numeric_limits<double>::infinity(),
+                     std::numeric_limits<double>::infinity(),
+                     std::numeric_limits<double>::infinity()),
+          maxCorner(-std::numeric_limits<double>::infinity(),
+                    -std::numeric_limits<double>::infinity(),
+                    -std::numeric_limits<double>::infinity()) {}
+
+    BoundingBox(const QuantumVector& lo, const QuantumVector& hi) : minCorner(lo), maxCorner(hi) {}
+
+    bool isEmpty() const { return minCorner.getX() > maxCorner.getX(); }
+
+    void expand(const QuantumVector& p) {
+        minCorner = QuantumVector(std::min(minCorner.getX(), p.getX()),
+                                  std::min(minCorner.getY(), p.getY()),
+                                  std::min(minCorner.getZ(), p.getZ()));
+        maxCorner = QuantumVector(std::max(maxCorner.getX(), p.getX()),
+                                  std::max(maxCorner.getY(), p.getY()),
+                                  std::max(maxCorner.getZ(), p.getZ()));
+    }
+
+    void merge(const BoundingBox& other) {
+        if (other.isEmpty()) return;
+        expand(other.minCorner);
+        expand(other.maxCorner);
+    }
+
+    BoundingBox padded(double margin) const {
+        return BoundingBox(minCorner - QuantumVector(margin, margin, margin),
+                           maxCorner + QuantumVector(margin, margin, margin));
+    }
+
+    QuantumVector getCenter() const { return (minCorner + maxCorner) * 0.5; }
+
+    double surfaceArea() const {
+        if (isEmpty()) return 0.0;
+        QuantumVector e = maxCorner - minCorner;
+        return 2.0 * (e.getX() * e.getY() + e.getY() * e.getZ() + e.getZ() * e.getX());
+    }
+
+    // Slab-тест; invDir = 1/direction по каждой оси
+    bool intersectRay(const QuantumVector& origin, const QuantumVector& invDir,
+                      double tMax, double& tNear) const {
+        double t0 = 0.0;
+        double t1 = tMax;
+        for (int axis = 0; axis < 3; ++axis) {
+            double tA = (minCorner[axis] - origin[axis]) * invDir[axis];
+            double tB = (maxCorner[axis] - origin[axis]) * invDir[axis];
+            if (tA > tB) std::swap(tA, tB);
+            t0 = tA > t0 ? tA : t0;
+            t1 = tB < t1 ? tB : t1;
+            if (t0 > t1) return false;
+        }
+        tNear = t0;
+        return true;
+    }
+};
+
+// Память, занятая сборкой: сборщики сообщают о каждом своём выделении и
+// освобождении, в том числе из параллельных задач. Пик - наибольший объём,
+// занятый одновременно, а не сумма итоговых массивов
+class BuildMemoryMeter {
+private:
+    std::atomic<size_t> current{0};
+    std::atomic<size_t> peak{0};
+
+public:
+    void reset() {
+        current = 0;
+        peak = 0;
+    }
+
+    void allocate(size_t bytes) {
+        size_t now = current.fetch_add(bytes) + bytes;
+        size_t seen = peak.load();
+        while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+        }
+    }
+
+    void release(size_t bytes) { current.fetch_sub(bytes); }
+
+    size_t getPeak() const { return peak.load(); }
+};
+
+// Общие шаги сборщиков иерархий: разбиение диапазона примитивов по binned SAH
+namespace SahBuilder {
+    // Поддеревья меньше этого порога строятся в текущем потоке
+    const int PARALLEL_SUBTREE_GRAIN = 4096;
+
+    // Глубина, до которой крупные поддеревья строятся отдельными задачами
+    int spawnDepth();
+
+    // Центры примитивов не хранятся: их даёт getCenter границ, и сборка не держит лишних 24 байт на примитив
+    void prepare(const std::vector<BoundingBox>& primitiveBounds, std::vector<int>& order);
+
+    BoundingBox rangeBounds(const std::vector<int>& order, const std::vector<BoundingBox>& primitiveBounds,
+                            int begin, int end, int chunks);
+
+    // Переставляет order[begin, end) и возвращает точку разреза; rangeBounds - границы диапазона
+    int split(std::vector<int>& order, const std::vector<BoundingBox>& primitiveBounds, int begin, int end,
+              int chunks, BoundingBox& rangeBounds);
+}
+
+struct HierarchyNode {
+    BoundingBox bounds;
+    int parent    = -1;
+    int left      = -1;
+    int right     = -1;
+    int primitive = -1; // >= 0 только у листьев
+    int height    = 0;
+
+    bool isLeaf() const { return primitive >= 0; }
+};
+
+// Стек обхода дерева: первые N записей лежат на стеке потока, глубже - в куче.
+// Вырожденное дерево (неудачные разбиения, вставки между перестройками) его не
+// переполнит, а на обычной глубине куча не трогается
+template <typename T, int N>
+class TraversalStack {
+private:
+    T local[N];
+    int top = 0;
+    // Заполняется только при полном local, поэтому снимается первым
+    std::vector<T> spill;
+
+public:
+    bool empty() const { return top == 0; }
+
+    void push(const T& value) {
+        if (top < N) {
+            local[top++] = value;
+        } else {
+            spill.push_back(value);
+        }
+    }
+
+    T pop() {
+        if (!spill.empty()) {
+            T value = spill.back();
+            spill.pop_back();
+            return value;
+        }
+        return local[--top];
+    }
+};
+
+// BVH над примитивами сцены: один примитив на лист, разбиение по binned SAH.
+// Полная сборка параллельна: крупные поддеревья строятся отдельными задачами.
+// Правки сцены вносятся инкрементально (вставка по SAH + AVL-повороты),
+// полная перестройка - только когда качество дерева заметно просело.
+class BoundingHierarchy {
+private:
+    std::vector<HierarchyNode> nodes;
+    std::vector<int> freeNodes;
+    std::vector<int> leafOfPrimitive;
+    int root = -1;
+
+    // Сумма площадей внутренних узлов - SAH-стоимость дерева без учёта листьев
+    double internalArea = 0.0;
+    double referenceCost = 0.0;
+
+    static const int MAX_STACK_DEPTH = 256;
+    static constexpr double REBUILD_THRESHOLD = 1.4;
+
+    int buildRange(std::vector<int>& order, const std::vector<BoundingBox>& primitiveBounds, int begin, int end,
+                   int nodeIndex, int parent, int spawnDepth);
+
+    int allocateNode();
+    void freeNode(int index);
+    void setInternalBounds(int index, const BoundingBox& bounds);
+    void refitFrom(int index);
+    int balance(int index);
+    int findBestSibling(const BoundingBox& bounds) const;
+    void removeLeaf(int leaf);
+    double currentCost() const;
+
+public:
+    // meter, если задан, получает выделения сборки; итоговое дерево остаётся в нём занятым
+    void build(const std::vector<BoundingBox>& primitiveBounds, BuildMemoryMeter* meter = nullptr);
+    void clear();
+
+    void insert(int primitive, const BoundingBox& bounds);
+    void remove(int primitive);
+    // Лист примитива from получает номер to; to в дереве быть не должно
+    void renumber(int from, int to);
+    bool contains(int primitive) const {
+        return primitive >= 0 && primitive < static_cast<int>(leafOfPrimitive.size()) && leafOfPrimitive[primitive] >= 0;
+    }
+
+    // Отношение текущей SAH-стоимости к стоимости после последней перестройки
+    double getQualityRatio() const;
+    bool needsRebuild() const { return getQualityRatio() > REBUILD_THRESHOLD; }
+
+    bool isEmpty() const { return root < 0; }
+    size_t getNodeCount() const { return nodes.size() - freeNodes.size(); }
+    size_t getMemoryUsage() const {
+        return nodes.capacity() * sizeof(HierarchyNode) +
+               (freeNodes.capacity() + leafOfPrimitive.capacity()) * sizeof(int);
+    }
+    const BoundingBox& getRootBounds() const { return nodes[root].bounds; }
+
+    // visit(primitive, tMax) сужает tMax при попадании; true - прекратить обход (any-hit)
+    template <typename Visitor>
+    void traverse(const QuantumVector& origin, const QuantumVector& direction,
+                  double& tMax, Visitor&& visit) const {
+        if (root < 0) return;
+
+        QuantumVector invDir(1.0 / direction.getX(), 1.0 / direction.getY(), 1.0 / direction.getZ());
+
+        double tNear;
+        if (!nodes[root].bounds.intersectRay(origin, invDir, tMax, tNear)) return;
+
+        TraversalStack<int, MAX_STACK_DEPTH> stack;
+        stack.push(root);
+
+        while (!stack.empty()) {
+            const HierarchyNode& node = nodes[stack.pop()];
+
+            if (node.isLeaf()) {
+                if (visit(node.primitive, tMax)) return;
+                continue;
+            }
+
+            double tLeft, tRight;
+            bool hitLeft  = nodes[node.left ].bounds.intersectRay(origin, invDir, tMax, tLeft);
+            bool hitRight = nodes[node.right].bounds.intersectRay(origin, invDir, tMax, tRight);
+
+            // Ближний ребёнок кладётся последним, чтобы обойти его первым
+            if (hitLeft && hitRight) {
+                if (tLeft < tRight) {
+                    stack.push(node.right);
+                    stack.push(node.left);
+                } else {
+                    stack.push(node.left);
+                    stack.push(node.right);
+                }
+            } else if (hitLeft) {
+                stack.push(node.left);
+            } else if (hitRight) {
+                stack.push(node.right);
+            }
+        }
+    }
+
+    // Обход пачкой лучей с общим началом: узел раскрывается, если его задевает хоть один
+    // луч пачки. visit(primitive, mask) получает маску лучей, дошедших до листа, и сама
+    // сужает их tMax
+    template <typename Visitor>
+    void traversePacket(const QuantumVector& origin, const QuantumVector* invDirections, int count,
+                        const double* tMax, Visitor&& visit) const {
+        if (root < 0) return;
+
+        // Начало общее, так что смещения граней коробки считаются один раз на всю пачку
+        auto rayMask = [&](const BoundingBox& bounds, bool firstOnly) {
+            QuantumVector lo = bounds.minCorner - origin;
+            QuantumVector hi = bounds.maxCorner - origin;
+            unsigned mask = 0;
+            for (int i = 0; i < count; ++i) {
+                const QuantumVector& invDir = invDirections[i];
+                double t0 = 0.0;
+                double t1 = tMax[i];
+                for (int axis = 0; axis < 3 && t0 <= t1; ++axis) {
+                    double tA = lo[axis] * invDir[axis];
+                    double tB = hi[axis] * invDir[axis];
+                    if (tA > tB) std::swap(tA, tB);
+                    t0 = tA > t0 ? tA : t0;
+                    t1 = tB < t1 ? tB : t1;
+                }
+                if (t0 <= t1) {
+                    mask |= 1u << i;
+                    if (firstOnly) break;
+                }
+            }
+            return mask;
+        };
+        auto anyRayHits = [&](const BoundingBox& bounds) { return rayMask(bounds, true) != 0; };
+
+        if (!anyRayHits(nodes[root].bounds)) return;
+
+        TraversalStack<int, MAX_STACK_DEPTH> stack;
+        stack.push(root);
+
+        while (!stack.empty()) {
+            const HierarchyNode& node = nodes[stack.pop()];
+
+            if (node.isLeaf()) {
+                unsigned mask = rayMask(node.bounds, false);
+                if (mask) visit(node.primitive, mask);
+                continue;
+            }
+
+            bool hitLeft  = anyRayHits(nodes[node.left ].bounds);
+            bool hitRight = anyRayHits(nodes[node.right].bounds);
+
+            // Лучи выходят из одной точки - ближний к ней ребёнок обходим первым
+            if (hitLeft && hitRight) {
+                QuantumVector toLeft  = nodes[node.left ].bounds.getCenter() - origin;
+                QuantumVector toRight = nodes[node.right].bounds.getCenter() - origin;
+                if (toLeft.dot(toLeft) < toRight.dot(toRight)) {
+                    stack.push(node.right);
+                    stack.push(node.left);
+                } else {
+                    stack.push(node.left);
+                    stack.push(node.right);
+                }
+            } else if (hitLeft) {
+                stack.push(node.left);
+            } else if (hitRight) {
+                stack.push(node.right);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "CompactHierarchy.hpp"
+#include "../core/WorkerPool.hpp"
+#include <cmath>
+
+void CompactHierarchy::clear() {
+    nodes.clear();
+    nodes.shrink_to_fit();
+    rootBounds = BoundingBox();
+}
+
+BoundingBox CompactHierarchy::encodeChild(CompactNode& node, int slot, const BoundingBox& frame,
+                                          const BoundingBox& bounds) {
+    QuantumVector extent = frame.maxCorner - frame.minCorner;
+    double decodedLo[3], decodedHi[3];
+
+    for (int axis = 0; axis < 3; ++axis) {
+        double frameMin = frame.minCorner[axis];
+        double frameExtent = extent[axis];
+
+        double lo = 0.0, hi = QUANT_STEPS;
+        if (frameExtent > 0.0) {
+            double scale = QUANT_STEPS / frameExtent;
+            lo = std::max(0.0, std::floor((bounds.minCorner[axis] - frameMin) * scale));
+            hi = std::min(QUANT_STEPS, std::ceil((bounds.maxCorner[axis] - frameMin) * scale));
+        }
+
+        // Округление должно только расширять коробку
+        while (lo > 0.0 && dequantize(frameMin, frameExtent, static_cast<std::uint16_t>(lo)) > bounds.minCorner[axis]) {
+            lo -= 1.0;
+        }
+        while (hi < QUANT_STEPS && dequantize(frameMin, frameExtent, static_cast<std::uint16_t>(hi)) < bounds.maxCorner[axis]) {
+            hi += 1.0;
+        }
+
+        node.lo[axis][slot] = static_cast<std::uint16_t>(lo);
+        node.hi[axis][slot] = static_cast<std::uint16_t>(hi);
+        decodedLo[axis] = dequantize(frameMin, frameExtent, node.lo[axis][slot]);
+        decodedHi[axis] = dequantize(frameMin, frameExtent, node.hi[axis][slot]);
+    }
+
+    return BoundingBox(QuantumVector(decodedLo[0], decodedLo[1], decodedLo[2]),
+                       QuantumVector(decodedHi[0], decodedHi[1], decodedHi[2]));
+}
+
+namespace {
+    // Узел от 4 примитивов всегда получает 4 ребёнка, меньший - по листу на примитив.
+    // По индукции поддерево из count примитивов занимает не больше (2 * count - 1) / 3 узлов
+    int maxNodes(int count) {
+        return std::max(1, (2 * count - 1) / 3);
+    }
+}
+
+void CompactHierarchy::build(std::vector<BoundingBox>&& primitiveBounds, BuildMemoryMeter* meter) {
+    clear();
+
+    int count = static_cast<int>(primitiveBounds.size());
+    if (count == 0) return;
+
+    std::vector<int> order;
+    SahBuilder::prepare(primitiveBounds, order);
+    size_t orderBytes = order.capacity() * sizeof(int);
+
+    // Корневая рамка чуть шире сцены, чтобы погрешность деквантования не срезала края
+    rootBounds = SahBuilder::rangeBounds(order, primitiveBounds, 0, count, 1);
+    double margin = 1e-9 * std::max(1.0, (rootBounds.maxCorner - rootBounds.minCorner).length());
+    rootBounds = rootBounds.padded(margin);
+
+    // Узлы пишутся сразу в итоговый массив: задача получает диапазон по maxNodes своего
+    // поддерева, так что задачи не пересекаются и ничего не копируют. Незанятые места
+    // помечены пустым первым ребёнком - у настоящего узла он есть всегда
+    CompactNode vacant = CompactNode();
+    for (int slot = 0; slot < WIDTH; ++slot) {
+        vacant.child[slot] = EMPTY_CHILD;
+    }
+    nodes.assign(maxNodes(count), vacant);
+    if (meter) {
+        meter->allocate(orderBytes + nodes.capacity() * sizeof(CompactNode));
+    }
+    int extent = buildNode(order, primitiveBounds, 0, count, rootBounds, SahBuilder::spawnDepth(), 0);
+
+    size_t boundsBytes = primitiveBounds.capacity() * sizeof(BoundingBox);
+    std::vector<int>().swap(order);
+    std::vector<BoundingBox>().swap(primitiveBounds);
+    if (meter) {
+        meter->release(orderBytes + boundsBytes);
+    }
+
+    removeGaps(extent, meter);
+    size_t reserved = nodes.capacity();
+    nodes.shrink_to_fit();
+    if (meter) {
+        meter->allocate(nodes.capacity() * sizeof(CompactNode));
+        meter->release(reserved * sizeof(CompactNode));
+    }
+}
+
+void CompactHierarchy::removeGaps(int extent, BuildMemoryMeter* meter) {
+    // Пропуск на задачу, поэтому их немного: конец каждого и сколько мест выброшено до него
+    std::vector<int> gapEnds;
+    std::vector<int> removedBefore;
+    int removed = 0;
+    for (int i = 0; i < extent;) {
+        if (nodes[i].child[0] != EMPTY_CHILD) {
+            ++i;
+            continue;
+        }
+        int gapStart = i;
+        while (i < extent && nodes[i].child[0] == EMPTY_CHILD) ++i;
+        removed += i - gapStart;
+        gapEnds.push_back(i);
+        removedBefore.push_back(removed);
+    }
+    size_t gapBytes = (gapEnds.capacity() + removedBefore.capacity()) * sizeof(int);
+    if (meter) {
+        meter->allocate(gapBytes);
+    }
+
+    auto shiftOf = [&](int index) {
+        auto gap = std::upper_bound(gapEnds.begin(), gapEnds.end(), index);
+        return gap == gapEnds.begin() ? 0 : removedBefore[gap - gapEnds.begin() - 1];
+    };
+
+    // Узлы только съезжают к началу, поэтому сдвиг на месте ничего не затирает
+    int used = 0;
+    for (int i = 0; i < extent; ++i) {
+        if (nodes[i].child[0] == EMPTY_CHILD) continue;
+        CompactNode node = nodes[i];
+        for (int slot = 0; slot < WIDTH; ++slot) {
+            if (node.child[slot] >= 0) node.child[slot] -= shiftOf(node.child[slot]);
+        }
+        nodes[used++] = node;
+    }
+    nodes.resize(used);
+
+    if (meter) {
+        meter->release(gapBytes);
+    }
+}
+
+int CompactHierarchy::buildNode(std::vector<int>& order, const std::vector<BoundingBox>& primitiveBounds,
+                                int begin, int end, const BoundingBox& frame, int spawnDepth, int nodeIndex) {
+    int chunks = spawnDepth > 0 ? (1 << std::min(spawnDepth, 5)) : 1;
+
+    // Дробим самый крупный диапазон, пока детей меньше WIDTH
+    int rangeBegin[WIDTH] = {begin};
+    int rangeEnd[WIDTH] = {end};
+    int rangeCount = 1;
+
+    while (rangeCount < WIDTH) {
+        int largest = -1;
+        for (int r = 0; r < rangeCount; ++r) {
+            int size = rangeEnd[r] - rangeBegin[r];
+            if (size > 1 && (largest < 0 || size > rangeEnd[largest] - rangeBegin[largest])) {
+                largest = r;
+            }
+        }
+        if (largest < 0) break;
+
+        BoundingBox unused;
+        int mid = SahBuilder::split(order, primitiveBounds, rangeBegin[largest], rangeEnd[largest], chunks, unused);
+        rangeBegin[rangeCount] = mid;
+        rangeEnd[rangeCount] = rangeEnd[largest];
+        rangeEnd[largest] = mid;
+        rangeCount++;
+    }
+
+    BoundingBox childFrames[WIDTH];
+    std::int32_t children[WIDTH];
+    for (int slot = 0; slot < WIDTH; ++slot) {
+        children[slot] = EMPTY_CHILD;
+    }
+
+    CompactNode encoded = CompactNode();
+    for (int slot = 0; slot < rangeCount; ++slot) {
+        BoundingBox bounds = SahBuilder::rangeBounds(order, primitiveBounds, rangeBegin[slot], rangeEnd[slot], chunks);
+        childFrames[slot] = encodeChild(encoded, slot, frame, bounds);
+    }
+    for (int slot = rangeCount; slot < WIDTH; ++slot) {
+        for (int axis = 0; axis < 3; ++axis) {
+            encoded.lo[axis][slot] = 0;
+            encoded.hi[axis][slot] = 0;
+        }
+    }
+
+    // Дети ложатся сразу за узлом: поддеревья этого потока вплотную, задачам - по maxNodes
+    int next = nodeIndex + 1;
+    WorkerPool& pool = WorkerPool::shared();
+    WorkerPool::TaskGroup tasks;
+
+    for (int slot = 0; slot < rangeCount; ++slot) {
+        if (rangeEnd[slot] - rangeBegin[slot] == 1) {
+            children[slot] = -1 - order[rangeBegin[slot]];
+        } else if (spawnDepth > 0 && rangeEnd[slot] - rangeBegin[slot] > SahBuilder::PARALLEL_SUBTREE_GRAIN) {
+            int from = rangeBegin[slot], to = rangeEnd[slot];
+            BoundingBox childFrame = childFrames[slot];
+            int childIndex = next;
+            children[slot] = childIndex;
+            next += maxNodes(to - from);
+            pool.submit(tasks, [&, from, to, childFrame, childIndex]() {
+                buildNode(order, primitiveBounds, from, to, childFrame, spawnDepth - 1, childIndex);
+            });
+        } else {
+            children[slot] = next;
+            next = buildNode(order, primitiveBounds, rangeBegin[slot], rangeEnd[slot], childFrames[slot], 0, next);
+        }
+    }
+    pool.wait(tasks);
+
+    for (int slot = 0; slot < WIDTH; ++slot) {
+        encoded.child[slot] = children[slot];
+    }
+    nodes[nodeIndex] = encoded;
+    return next;
+}
@@ -0,0 +1,118 @@
+#ifndef COMPACT_HIERARCHY_HPP
+#define COMPACT_HIERARCHY_HPP
+
+#include "BoundingHierarchy.hpp"
+#include <cstdint>
+#include <vector>
+
+// Узел 4-арного дерева ровно в одну кэш-линию: границы детей квантованы в 16 бит
+// относительно коробки самого узла, которая восстанавливается при спуске от корня
+struct alignas(64) CompactNode {
+    std::uint16_t lo[3][4];
+    std::uint16_t hi[3][4];
+    std::int32_t child[4]; // >= 0 - узел, < 0 - лист с примитивом -1-child
+};
+
+static_assert(sizeof(CompactNode) == 64, "CompactNode must fill exactly one cache line");
+
+// Сжатая BVH для огромных статичных сцен. Строится сразу в 4-арном виде
+// тем же binned SAH, без промежуточного бинарного дерева.
+class CompactHierarchy {
+private:
+    std::vector<CompactNode> nodes;
+    BoundingBox rootBounds;
+
+    static const int WIDTH = 4;
+    static const int MAX_STACK_DEPTH = 256;
+    static const std::int32_t EMPTY_CHILD = INT32_MIN;
+    static constexpr double QUANT_STEPS = 65535.0;
+
+    static double dequantize(double frameMin, double frameExtent, std::uint16_t q) {
+        return frameMin + q * frameExtent / QUANT_STEPS;
+    }
+
+    static BoundingBox decodeChild(const CompactNode& node, int slot, const BoundingBox& frame) {
+        QuantumVector extent = frame.maxCorner - frame.minCorner;
+        return BoundingBox(
+            QuantumVector(dequantize(frame.minCorner.getX(), extent.getX(), node.lo[0][slot]),
+                          dequantize(frame.minCorner.getY(), extent.getY(), node.lo[1][slot]),
+                          dequantize(frame.minCorner.getZ(), extent.getZ(), node.lo[2][slot])),
+            QuantumVector(dequantize(frame.minCorner.getX(), extent.getX(), node.hi[0][slot]),
+                          dequantize(frame.minCorner.getY(), extent.getY(), node.hi[1][slot]),
+                          dequantize(frame.minCorner.getZ(), extent.getZ(), node.hi[2][slot])));
+    }
+
+    static BoundingBox encodeChild(CompactNode& node, int slot, const BoundingBox& frame, const BoundingBox& bounds);
+
+    // Пишет узел в nodeIndex, его поддерево - следом; возвращает конец занятого диапазона
+    int buildNode(std::vector<int>& order, const std::vector<BoundingBox>& primitiveBounds, int begin, int end,
+                  const BoundingBox& frame, int spawnDepth, int nodeIndex);
+    // Вырезает незанятые хвосты диапазонов задач и сдвигает ссылки на детей
+    void removeGaps(int extent, BuildMemoryMeter* meter);
+
+public:
+    // Границы забираются: после разбиения они не нужны и освобождаются до ужатия узлов.
+    // meter, если задан, уже должен учитывать их; в остальном контракт как у BoundingHierarchy::build
+    void build(std::vector<BoundingBox>&& primitiveBounds, BuildMemoryMeter* meter = nullptr);
+    void clear();
+
+    bool isEmpty() const { return nodes.empty(); }
+    size_t getNodeCount() const { return nodes.size(); }
+    size_t getMemoryUsage() const { return nodes.capacity() * sizeof(CompactNode); }
+
+    // Тот же контракт, что у BoundingHierarchy::traverse
+    template <typename Visitor>
+    void traverse(const QuantumVector& origin, const QuantumVector& direction,
+                  double& tMax, Visitor&& visit) const {
+        if (nodes.empty()) return;
+
+        QuantumVector invDir(1.0 / direction.getX(), 1.0 / direction.getY(), 1.0 / direction.getZ());
+
+        double tNear;
+        if (!rootBounds.intersectRay(origin, invDir, tMax, tNear)) return;
+
+        struct StackEntry {
+            std::int32_t ref;
+            BoundingBox frame;
+        };
+        TraversalStack<StackEntry, MAX_STACK_DEPTH> stack;
+        stack.push({0, rootBounds});
+
+        while (!stack.empty()) {
+            StackEntry entry = stack.pop();
+
+            if (entry.ref < 0) {
+                if (visit(-1 - entry.ref, tMax)) return;
+                continue;
+            }
+
+            const CompactNode& node = nodes[entry.ref];
+
+            StackEntry hits[WIDTH];
+            double hitT[WIDTH];
+            int hitCount = 0;
+
+            for (int slot = 0; slot < WIDTH && node.child[slot] != EMPTY_CHILD; ++slot) {
+                BoundingBox box = decodeChild(node, slot, entry.frame);
+                if (!box.intersectRay(origin, invDir, tMax, tNear)) continue;
+
+                // Вставка по возрастанию tNear
+                int pos = hitCount++;
+                while (pos > 0 && hitT[pos - 1] > tNear) {
+                    hits[pos] = hits[pos - 1];
+                    hitT[pos] = hitT[pos - 1];
+                    pos--;
+                }
+                hits[pos] = {node.child[slot], box};
+                hitT[pos] = tNear;
+            }
+
+            // Ближние кладутся последними, чтобы обойти их первыми
+            for (int i = hitCount - 1; i >= 0; --i) {
+                stack.push(hits[i]);
+            }
+        }
+    }
+};
+
+#endif
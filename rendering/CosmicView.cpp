@@ -1,29 +1,111 @@
 #include "CosmicView.hpp"
 #include "../system/RenderEngine.hpp"
 #include <iostream>
-#include <thread>
 #include <vector>
-#include <future>
+#include <algorithm>
+#include <cmath>
 
-static void renderRegionTask(RayTracer& tracer, std::vector<PhotonColor>& buffer, 
-                            int width, int height, int startY, int endY,
-                            const QuantumVector& observerPos, const QuantumVector& observerDir,
-                            const QuantumVector& right, const QuantumVector& up,
-                            double aspectRatio, double fov, std::atomic<int>& completedRows) {
-    for (int y = startY; y < endY; y++) {
-        for (int x = 0; x < width; x++) {
-            double ndcX = (x + 0.5) / width * 2.0 - 1.0;
-            double ndcY = 1.0 - (y + 0.5) / height * 2.0;
+// Раскладывает объекты по плиткам, куда попадает проекция их коробок.
+// Коробка, пересекающая плоскость камеры, достаётся всем плиткам.
+static void binObjectsToTiles(const RayTracer& tracer, const FrameCamera& camera,
+                              int tilesX, int tilesY, std::vector<TileCandidates>& tileObjects) {
+    const double nearDepth = 1e-6;
+    
+    // На большой сцене почти все плитки всё равно уйдут в BVH - не тратим проход
+    if (tracer.getObjectCount() > CosmicView::BINNING_MAX_OBJECTS) {
+        for (auto& candidates : tileObjects) {
+            candidates.useHierarchy = true;
+        }
+        return;
+    }
+    
+    size_t tileCount = tileObjects.size();
+    size_t overflowedTiles = 0;
+    for (size_t i = 0; i < tracer.getObjectCount() && overflowedTiles < tileCount; ++i) {
+        BoundingBox bounds = tracer.getObjectBounds(i);
+        
+        double minX = 1e30, maxX = -1e30, minY = 1e30, maxY = -1e30;
+        int behind = 0;
+        for (int corner = 0; corner < 8; ++corner) {
+            QuantumVector point((corner & 1) ? bounds.maxCorner.getX() : bounds.minCorner.getX(),
+                                (corner & 2) ? bounds.maxCorner.getY() : bounds.minCorner.getY(),
+                                (corner & 4) ? bounds.maxCorner.getZ() : bounds.minCorner.getZ());
+            QuantumVector view = point - camera.position;
+            double depth = view.dot(camera.direction);
+            if (depth <= nearDepth) {
+                behind++;
+                continue;
+            }
             
-            ndcX *= aspectRatio * fov;
-            ndcY *= fov;
+            double px = (view.dot(camera.right) / depth / camera.scaleX + 1.0) * 0.5 * camera.width - 0.5;
+            double py = (1.0 - view.dot(camera.up) / depth / camera.scaleY) * 0.5 * camera.height - 0.5;
+            minX = std::min(minX, px);
+            maxX = std::max(maxX, px);
+            minY = std::min(minY, py);
+            maxY = std::max(maxY, py);
+        }
+        if (behind == 8) continue;
+        
+        int tileX0 = 0, tileX1 = tilesX - 1, tileY0 = 0, tileY1 = tilesY - 1;
+        if (behind == 0) {
+            // Пиксель запаса на округление
+            if (maxX < -1.0 || minX > camera.width || maxY < -1.0 || minY > camera.height) continue;
+            tileX0 = std::max(0, static_cast<int>(std::floor(minX)) - 1) / CosmicView::TILE_SIZE;
+            tileX1 = std::min(camera.width - 1, static_cast<int>(std::ceil(maxX)) + 1) / CosmicView::TILE_SIZE;
+            tileY0 = std::max(0, static_cast<int>(std::floor(minY)) - 1) / CosmicView::TILE_SIZE;
+            tileY1 = std::min(camera.height - 1, static_cast<int>(std::ceil(maxY)) + 1) / CosmicView::TILE_SIZE;
+        }
+        
+        for (int ty = tileY0; ty <= tileY1; ++ty) {
+            for (int tx = tileX0; tx <= tileX1; ++tx) {
+                TileCandidates& candidates = tileObjects[ty * tilesX + tx];
+                if (candidates.useHierarchy) continue;
+                
+                candidates.add(static_cast<int>(i));
+                overflowedTiles += candidates.useHierarchy;
+            }
+        }
+    }
+}
+
+// false - кадр отменён, плитка дорисована не до конца
+static bool renderTile(RayTracer& tracer, FrameBuffer& buffer, const FrameCamera& camera,
+                       int tilesX, int tile, TileCandidates& candidates,
+                       const std::atomic<bool>& cancelled) {
+    int startX = (tile % tilesX) * CosmicView::TILE_SIZE;
+    int startY = (tile / tilesX) * CosmicView::TILE_SIZE;
+    int endX = std::min(startX + CosmicView::TILE_SIZE, camera.width);
+    int endY = std::min(startY + CosmicView::TILE_SIZE, camera.height);
+    
+    tracer.prepareTileCandidates(candidates);
+    
+    // Плитка идёт квадратиками пикселей: соседние лучи обходят сцену одной пачкой
+    for (int packetY = startY; packetY < endY; packetY += CosmicView::PACKET_SIZE) {
+        // Проверка на каждый ряд пачек: плитку со стеклом не дожидаемся целиком
+        if (cancelled.load(std::memory_order_relaxed)) return false;
+        
+        for (int packetX = startX; packetX < endX; packetX += CosmicView::PACKET_SIZE) {
+            RayPacket packet;
+            packet.origin = camera.position;
+            int pixelX[RayPacket::MAX_RAYS], pixelY[RayPacket::MAX_RAYS];
+            
+            for (int y = packetY; y < std::min(packetY + CosmicView::PACKET_SIZE, endY); y++) {
+                for (int x = packetX; x < std::min(packetX + CosmicView::PACKET_SIZE, endX); x++) {
+                    pixelX[packet.count] = x;
+                    pixelY[packet.count] = y;
+                    packet.add(camera.rayThrough(x, y));
+                }
+            }
             
-            QuantumVector rayDir = (observerDir + right * ndcX + up * ndcY).normalize();
-            PhotonColor color = tracer.traceRay(observerPos, rayDir);
-            buffer[y * width + x] = color;
+            PhotonRadiance colors[RayPacket::MAX_RAYS];
+            tracer.tracePrimaryPacket(packet, candidates, colors);
+            // Единственное место, где яркость становится 8-битным цветом
+            for (int i = 0; i < packet.count; i++) {
+                buffer.setPixel(pixelX[i], pixelY[i], colors[i].toColor());
+            }
         }
-        completedRows++;
     }
+    return true;
 }
 
 CosmicView::CosmicView(const QuantumVector& pos, const QuantumVector& size, 
@@ -32,9 +114,30 @@ CosmicView::CosmicView(const QuantumVector& pos, const QuantumVector& size,
     // Рендерим в увеличенном разрешении для качества
     bufferWidth = static_cast<int>(size.getX()) * 2;
     bufferHeight = static_cast<int>(size.getY()) * 2;
-    frameBuffer.resize(bufferWidth * bufferHeight);
+    frameBuffer.resize(bufferWidth, bufferHeight);
+    
+    tilesX = (bufferWidth + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (bufferHeight + TILE_SIZE - 1) / TILE_SIZE;
+    tileObjects.resize(tilesX * tilesY);
+    
+    photonTracer.setEditGuard([this]() { stopFrame(); });
+}
+
+CosmicView::~CosmicView() {
+    photonTracer.setEditGuard(nullptr);
+    // Задачи кадра ссылаются на буфер и плитки - дожидаемся их
+    frameCancelled = true;
+    WorkerPool::shared().wait(frameTasks);
+}
+
+void CosmicView::stopFrame() {
+    needsRedraw = true;
+    if (!isRendering) return;
     
-    threadCount = std::max(1u, std::thread::hardware_concurrency());
+    // Отменённые плитки выходят за ряд пачек - ожидание короткое
+    frameCancelled = true;
+    WorkerPool::shared().wait(frameTasks);
+    isRendering = false;
 }
 
 void CosmicView::render(RenderEngine& engine) {
@@ -46,27 +149,29 @@ void CosmicView::render(RenderEngine& engine) {
     engine.drawRect(absPos.getX(), absPos.getY(), dimensions.getX(), dimensions.getY(),
                    NexusColors::Void, borderColor, 3);
     
-    if (needsRedraw) {
+    if (needsRedraw || isRendering) {
         renderFrameAsync();
     }
     
     if (isRendering) {
-        double progress = static_cast<double>(completedRows) / bufferHeight;
+        double progress = static_cast<double>(completedTiles) / (tilesX * tilesY);
         std::string progressText = "Rendering: " + std::to_string(static_cast<int>(progress * 100)) + "%";
         engine.drawText(absPos.getX() + 10, absPos.getY() + dimensions.getY() - 30, 
                        progressText, NexusColors::Plasma, 12);
     }
     
-    // Масштабируем отображение - показываем каждый пиксель из буфера
-    for (int py = 0; py < bufferHeight; py++) {
-        for (int px = 0; px < bufferWidth; px++) {
-            PhotonColor color = frameBuffer[py * bufferWidth + px];
-            // Масштабируем координаты для отображения в области просмотра
-            int displayX = absPos.getX() + px / 2;
-            int displayY = absPos.getY() + py / 2;
-            engine.drawRect(displayX, displayY, 1, 1, color);
-        }
+    // Новая текстура получает текущий кадр, дальше загружаем только свежие.
+    // Кадр, взятый acquireFront, пул не трогает - читаем без блокировок
+    bool created = frameTexture.getSize().x != static_cast<unsigned>(bufferWidth);
+    if (created) {
+        frameTexture.create(bufferWidth, bufferHeight);
+        frameTexture.setSmooth(true);
+    }
+    if (frameBuffer.acquireFront() || created) {
+        frameTexture.update(frameBuffer.getPixels());
     }
+    // Буфер рендерится в двойном разрешении - при выводе уменьшаем с фильтрацией
+    engine.drawTexture(absPos.getX(), absPos.getY(), frameTexture, 0.5);
     
     std::string status = focused ? 
         "QUANTUM VIEW [ACTIVE - WASD Move, QE Rotate, ZX Look]" : 
@@ -86,47 +191,78 @@ void CosmicView::render(RenderEngine& engine) {
 
 void CosmicView::renderFrameAsync() {
     if (isRendering) {
-        if (completedRows >= bufferHeight) {
-            isRendering = false;
-            needsRedraw = false;
-            renderFuture.get();
-        }
-        return;
+        // Отменённый кадр досчитывает только проверки флага - это доли миллисекунды
+        if (!frameTasks.isDone()) return;
+        
+        isRendering = false;
+        WorkerPool::shared().wait(frameTasks);
+        if (!needsRedraw) return;
     }
     
+    // Ввод, пришедший во время этого кадра, снова поднимет флаг и запустит следующий
+    needsRedraw = false;
     isRendering = true;
-    completedRows = 0;
+    completedTiles = 0;
+    swizzledRows = 0;
+    frameCancelled = false;
+    setupCamera();
     
-    renderFuture = std::async(std::launch::async, [this]() {
+    // Раскладка по плиткам тоже идёт в пуле - поток интерфейса только ставит задачу
+    WorkerPool::shared().submit(frameTasks, [this]() {
         renderFrame();
     });
 }
 
-void CosmicView::renderFrame() {
-    QuantumVector observerPos = photonTracer.getObserverPosition();
-    QuantumVector observerDir = photonTracer.getObserverDirection();
+// Камера снимается в потоке интерфейса - ввод меняет позицию наблюдателя, пока пул рисует
+void CosmicView::setupCamera() {
+    FrameCamera& camera = frameCamera;
+    camera.position = photonTracer.getObserverPosition();
+    camera.direction = photonTracer.getObserverDirection();
     
-    QuantumVector right = QuantumVector(0, 1, 0).cross(observerDir).normalize();
-    QuantumVector up = observerDir.cross(right).normalize();
+    camera.right = QuantumVector(0, 1, 0).cross(camera.direction).normalize();
+    camera.up = camera.direction.cross(camera.right).normalize();
     
     double aspectRatio = static_cast<double>(bufferWidth) / bufferHeight;
     double fov = 1.0;
+    camera.scaleX = aspectRatio * fov;
+    camera.scaleY = fov;
+    camera.width = bufferWidth;
+    camera.height = bufferHeight;
+}
+
+void CosmicView::renderFrame() {
+    if (frameCancelled.load(std::memory_order_relaxed)) return;
     
-    std::vector<std::future<void>> futures;
-    int rowsPerThread = bufferHeight / threadCount;
-    
-    for (int t = 0; t < threadCount; ++t) {
-        int startY = t * rowsPerThread;
-        int endY = (t == threadCount - 1) ? bufferHeight : (t + 1) * rowsPerThread;
-        
-        futures.push_back(std::async(std::launch::async, renderRegionTask,
-            std::ref(photonTracer), std::ref(frameBuffer), 
-            bufferWidth, bufferHeight, startY, endY,
-            observerPos, observerDir, right, up, aspectRatio, fov, std::ref(completedRows)));
+    // ОПТИМИЗАЦИЯ: каждая плитка трассирует первичные лучи только по своим объектам
+    for (auto& candidates : tileObjects) {
+        candidates.reset();
     }
+    binObjectsToTiles(photonTracer, frameCamera, tilesX, tilesY, tileObjects);
     
-    for (auto& future : futures) {
-        future.get();
+    // Плитка - отдельная задача: пока один поток сидит в плитке со стеклом,
+    // остальные разбирают очереди друг друга
+    WorkerPool& pool = WorkerPool::shared();
+    int tileCount = tilesX * tilesY;
+    for (int tile = 0; tile < tileCount; ++tile) {
+        pool.submit(frameTasks, [this, tile, tileCount]() {
+            if (!renderTile(photonTracer, frameBuffer, frameCamera, tilesX, tile, tileObjects[tile],
+                            frameCancelled)) {
+                return;
+            }
+            
+            // Последняя плитка запускает перестановку в построчный кадр - по ряду плиток
+            // на задачу. Оборванный кадр сюда не доходит: на экране остаётся прошлый целый
+            if (completedTiles.fetch_add(1) + 1 == tileCount) {
+                for (int tileY = 0; tileY < tilesY; ++tileY) {
+                    WorkerPool::shared().submit(frameTasks, [this, tileY]() {
+                        frameBuffer.swizzleTileRow(tileY);
+                        if (swizzledRows.fetch_add(1) + 1 == tilesY) {
+                            frameBuffer.publish();
+                        }
+                    });
+                }
+            }
+        });
     }
 }
 
@@ -146,10 +282,7 @@ void CosmicView::onQuantumClick(const QuantumVector& position, bool pressed) {
 
 void CosmicView::onNexusPress(int key, bool pressed) {
     if (focused && pressed) {
-        observer.handleKey(key);
-        photonTracer.setObserverPosition(observer.getPosition());
-        photonTracer.setObserverDirection(observer.getDirection());
-        needsRedraw = true;
+        moveObserver(key);
     }
     
     CosmicElement::onNexusPress(key, pressed);
@@ -158,10 +291,7 @@ void CosmicView::onNexusPress(int key, bool pressed) {
 EventFlow CosmicView::processSignal(CosmicSignal& signal) {
     if (auto pressSignal = dynamic_cast<NexusPressSignal*>(&signal)) {
         if (focused && pressSignal->isPressed()) {
-            observer.handleKey(pressSignal->getKey());
-            photonTracer.setObserverPosition(observer.getPosition());
-            photonTracer.setObserverDirection(observer.getDirection());
-            needsRedraw = true;
+            moveObserver(pressSignal->getKey());
             return StopFlow;
         }
     }
@@ -171,4 +301,15 @@ EventFlow CosmicView::processSignal(CosmicSignal& signal) {
     }
     
     return CosmicElement::processSignal(signal);
+}
+
+void CosmicView::moveObserver(int key) {
+    observer.handleKey(key);
+    photonTracer.setObserverPosition(observer.getPosition());
+    photonTracer.setObserverDirection(observer.getDirection());
+    needsRedraw = true;
+    // Плитки старого кадра уже не нужны - освобождаем пул под кадр с новой позиции
+    if (isRendering) {
+        frameCancelled = true;
+    }
 }
\ No newline at end of file
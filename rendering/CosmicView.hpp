@@ -3,9 +3,10 @@
 
 #include "../interface/CosmicElement.hpp"
 #include "PhotonTracer.hpp"
+#include "FrameBuffer.hpp"
+#include "../core/WorkerPool.hpp"
+#include <SFML/Graphics.hpp>
 #include <vector>
-#include <thread>
-#include <future>
 #include <atomic>
 
 class ObserverController {
@@ -53,31 +54,68 @@ public:
     const QuantumVector& getDirection() const { return direction; }
 };
 
+// Камера кадра: всё, что нужно задачам плиток, чтобы построить луч через пиксель
+struct FrameCamera {
+    QuantumVector position;
+    QuantumVector direction;
+    QuantumVector right;
+    QuantumVector up;
+    double scaleX, scaleY;
+    int width, height;
+    
+    QuantumVector rayThrough(int x, int y) const {
+        double ndcX = ((x + 0.5) / width * 2.0 - 1.0) * scaleX;
+        double ndcY = (1.0 - (y + 0.5) / height * 2.0) * scaleY;
+        return (direction + right * ndcX + up * ndcY).normalize();
+    }
+};
+
 class CosmicView : public CosmicElement {
 private:
     RayTracer& photonTracer;
     ObserverController& observer;
-    std::vector<PhotonColor> frameBuffer;
+    FrameBuffer frameBuffer;
+    // Кадр целиком уходит в текстуру одной загрузкой; создаётся в потоке интерфейса
+    sf::Texture frameTexture;
     int bufferWidth, bufferHeight;
     bool focused = false;
     bool needsRedraw = true;
     bool isRendering = false;
-    std::atomic<int> completedRows{0};
-    std::future<void> renderFuture;
-    unsigned int threadCount;
+    std::atomic<int> completedTiles{0};
+    std::atomic<int> swizzledRows{0};
+    // Ввод сдвинул камеру - плитки кадра в работе бросают трассировку
+    std::atomic<bool> frameCancelled{false};
+    int tilesX = 0, tilesY = 0;
+    // Кадр в работе: плитки идут отдельными задачами общего пула и читают отсюда
+    FrameCamera frameCamera;
+    std::vector<TileCandidates> tileObjects;
+    WorkerPool::TaskGroup frameTasks;
 
 public:
+    // Плитка рендера совпадает с плиткой буфера - задача пишет только в свою память
+    static const int TILE_SIZE = FrameBuffer::TILE_SIZE;
+    // Сторона квадратика первичных лучей, идущих пачкой; PACKET_SIZE^2 <= RayPacket::MAX_RAYS
+    static const int PACKET_SIZE = 4;
+    // Больше объектов - плитки не раскладываются, все первичные лучи идут через BVH
+    static const size_t BINNING_MAX_OBJECTS = 50000;
+    
     CosmicView(const QuantumVector& pos, const QuantumVector& size, 
                RayTracer& tracer, ObserverController& controller);
+    ~CosmicView() override;
     
     void render(RenderEngine& engine) override;
     void onQuantumClick(const QuantumVector& position, bool pressed) override;
     void onNexusPress(int key, bool pressed) override;
     EventFlow processSignal(CosmicSignal& signal) override;
+    // Камера сдвинулась: текущий кадр прерывается, следующий строится с новой позиции
+    void moveObserver(int key);
 
 private:
     void renderFrame();
     void renderFrameAsync();
+    void setupCamera();
+    // Правка сцены: кадр прерывается и дожидается, после правки рисуется заново
+    void stopFrame();
 };
 
 #endif
\ No newline at end of file
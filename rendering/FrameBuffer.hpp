@@ -0,0 +1,117 @@
+#ifndef FRAME_BUFFER_HPP
+#define FRAME_BUFFER_HPP
+
+#include "../core/QuantumCore.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Кадр плитками TILE_SIZE x TILE_SIZE, плитки подряд построчно. Внутри плитки
+// пиксели идут по кривой Мортона: каждые 16 подряд - квадрат 4x4 ровно в одну
+// строку кэша, а вся плитка - свои 4 КБ. Поток, рендерящий плитку, не делит
+// строк кэша с соседями. Для текстуры плитки переставляются в построчный RGBA8.
+// Построчных кадров три: в один пишет пул, один показывает интерфейс, третий -
+// последний готовый. Пул и интерфейс обмениваются ими атомарно и не ждут друг друга
+class FrameBuffer {
+private:
+    struct alignas(64) CacheLine {
+        std::uint8_t bytes[64];
+    };
+
+    // Флаг рядом с номером готового кадра: интерфейс ещё не забирал его
+    static const unsigned FRESH_FRAME = 4;
+
+    std::vector<CacheLine> tiles;
+    // Построчный RGBA8 без промежутков - ровно то, что принимает sf::Texture::update
+    std::vector<CacheLine> linear[3];
+    int backImage = 0;                    // собирается пулом
+    int frontImage = 1;                   // загружается интерфейсом
+    std::atomic<unsigned> readyImage{2};  // последний готовый, с флагом FRESH_FRAME
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+
+    // Биты координаты внутри плитки расходятся через один - между ними встают биты другой
+    static std::uint32_t spreadBits(std::uint32_t value) {
+        value = (value | (value << 4)) & 0x0f0f;
+        value = (value | (value << 2)) & 0x3333;
+        value = (value | (value << 1)) & 0x5555;
+        return value;
+    }
+
+    std::uint8_t* tilePixel(int x, int y) {
+        size_t tile = static_cast<size_t>(y / TILE_SIZE) * tilesX + x / TILE_SIZE;
+        std::uint32_t inside = spreadBits(x % TILE_SIZE) | spreadBits(y % TILE_SIZE) << 1;
+        return tiles.data()->bytes + (tile * TILE_SIZE * TILE_SIZE + inside) * BYTES_PER_PIXEL;
+    }
+
+public:
+    static const int TILE_SIZE = 32;
+    static const int BYTES_PER_PIXEL = 4;
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+        size_t tileBytes = static_cast<size_t>(TILE_SIZE) * TILE_SIZE * BYTES_PER_PIXEL;
+        tiles.assign(static_cast<size_t>(tilesX) * tilesY * tileBytes / sizeof(CacheLine), CacheLine{});
+        size_t bytes = static_cast<size_t>(w) * h * BYTES_PER_PIXEL;
+        for (auto& image : linear) {
+            image.assign((bytes + sizeof(CacheLine) - 1) / sizeof(CacheLine), CacheLine{});
+        }
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getTilesX() const { return tilesX; }
+    int getTilesY() const { return tilesY; }
+
+    void setPixel(int x, int y, const PhotonColor& color) {
+        std::uint8_t* pixel = tilePixel(x, y);
+        pixel[0] = static_cast<std::uint8_t>(color.getR());
+        pixel[1] = static_cast<std::uint8_t>(color.getG());
+        pixel[2] = static_cast<std::uint8_t>(color.getB());
+        pixel[3] = 255;
+    }
+
+    // Переставляет ряд плиток tileY в собираемый построчный кадр. Ряды
+    // независимы - их можно разбирать параллельно
+    void swizzleTileRow(int tileY) {
+        int startY = tileY * TILE_SIZE;
+        int endY = std::min(startY + TILE_SIZE, height);
+        std::uint8_t* image = linear[backImage].data()->bytes;
+        for (int y = startY; y < endY; ++y) {
+            std::uint8_t* row = image + static_cast<size_t>(y) * width * BYTES_PER_PIXEL;
+            for (int x = 0; x < width; ++x) {
+                std::memcpy(row + static_cast<size_t>(x) * BYTES_PER_PIXEL, tilePixel(x, y), BYTES_PER_PIXEL);
+            }
+        }
+    }
+
+    // Пул, когда все ряды переставлены: собранный кадр становится готовым, а
+    // прежний готовый, если интерфейс его так и не взял, идёт под следующий
+    void publish() {
+        backImage = static_cast<int>(readyImage.exchange(backImage | FRESH_FRAME, std::memory_order_acq_rel) & ~FRESH_FRAME);
+    }
+
+    // Интерфейс: забирает новый готовый кадр, если он есть. false - показывать прежний
+    bool acquireFront() {
+        if (!(readyImage.load(std::memory_order_relaxed) & FRESH_FRAME)) return false;
+        frontImage = static_cast<int>(readyImage.exchange(frontImage, std::memory_order_acq_rel) & ~FRESH_FRAME);
+        return true;
+    }
+
+    // Кадр, взятый последним acquireFront; пул в него не пишет
+    const std::uint8_t* getPixels() const { return linear[frontImage].data()->bytes; }
+    size_t getMemoryUsage() const {
+        size_t lines = tiles.size();
+        for (const auto& image : linear) lines += image.size();
+        return lines * sizeof(CacheLine);
+    }
+};
+
+#endif
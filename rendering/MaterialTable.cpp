@@ -0,0 +1,37 @@
+#include "MaterialTable.hpp"
+#include <cmath>
+
+Material::Material(const PhotonColor& color, double reflectivity, double transparency, double refractiveIndex,
+                   double shininess, bool emissive)
+    : color(color), reflectivity(reflectivity), transparency(transparency),
+      refractiveIndex(refractiveIndex), shininess(shininess) {
+    materialClass = 0;
+    if (shininess > 10.0) materialClass |= TERM_SPECULAR;
+    if (reflectivity > 0.001) materialClass |= TERM_REFLECTION;
+    if (transparency > 0.001) materialClass |= TERM_REFRACTION;
+    if (emissive) materialClass = MATERIAL_EMISSIVE;
+
+    radiance = PhotonRadiance(color);
+    albedo = radiance * (1.0f / 255);
+    ambient = radiance * static_cast<float>(AMBIENT_STRENGTH);
+
+    // Квадрат не зависит от направления перехода через границу
+    fresnelR0 = std::pow((1.0 - refractiveIndex) / (1.0 + refractiveIndex), 2.0);
+
+    double exponent = shininess * 0.1;
+    for (int sample = 0; sample <= SPECULAR_SAMPLES; ++sample) {
+        specularCurve[sample] = static_cast<float>(std::pow(static_cast<double>(sample) / SPECULAR_SAMPLES, exponent));
+    }
+}
+
+int MaterialTable::intern(const PhotonColor& color, double reflectivity, double transparency, double refractiveIndex,
+                          double shininess, bool emissive) {
+    Key key(color.value, reflectivity, transparency, refractiveIndex, shininess, emissive);
+    auto found = lookup.find(key);
+    if (found != lookup.end()) return found->second;
+
+    int index = static_cast<int>(materials.size());
+    materials.emplace_back(color, reflectivity, transparency, refractiveIndex, shininess, emissive);
+    lookup.emplace(key, index);
+    return index;
+}
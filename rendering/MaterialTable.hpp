@@ -0,0 +1,72 @@
+#ifndef MATERIAL_TABLE_HPP
+#define MATERIAL_TABLE_HPP
+
+#include "../core/QuantumCore.hpp"
+#include <deque>
+#include <map>
+#include <tuple>
+
+// Слагаемые шейдинга. Класс материала - набор тех, что у него вообще есть:
+// без слагаемых - diffuse, с бликом - glossy, с отражением - mirror, с преломлением - dielectric.
+// Для каждого класса собирается свой вариант шейдинга без лишних проверок
+enum MaterialTerm {
+    TERM_SPECULAR   = 1,
+    TERM_REFLECTION = 2,
+    TERM_REFRACTION = 4
+};
+
+// Источники света только светятся - отдельный класс после всех наборов слагаемых
+const int MATERIAL_EMISSIVE = 8;
+const int MATERIAL_CLASS_COUNT = 9;
+
+// Параметры поверхности и посчитанные по ним заранее константы шейдинга
+struct Material {
+    static constexpr double AMBIENT_STRENGTH = 0.05;
+    static const int SPECULAR_SAMPLES = 256;
+
+    PhotonColor color;
+    double reflectivity;
+    double transparency;
+    double refractiveIndex;
+    double shininess;
+
+    int materialClass;
+    PhotonRadiance radiance; // цвет как яркость - так светятся источники
+    PhotonRadiance albedo;   // доля падающего света, рассеиваемая по каналам
+    PhotonRadiance ambient;  // фоновая подсветка, уже умноженная на цвет
+    double fresnelR0;                    // отражение при нормальном падении на границе с воздухом
+    // pow(x, shininess * 0.1) в равных шагах по x из [0, 1], между ними - линейно
+    float specularCurve[SPECULAR_SAMPLES + 1];
+
+    Material(const PhotonColor& color, double reflectivity, double transparency, double refractiveIndex,
+             double shininess, bool emissive);
+
+    double specular(double cosine) const {
+        double position = cosine * SPECULAR_SAMPLES;
+        int sample = static_cast<int>(position);
+        if (sample >= SPECULAR_SAMPLES) return specularCurve[SPECULAR_SAMPLES];
+        double fraction = position - sample;
+        return specularCurve[sample] + (specularCurve[sample + 1] - specularCurve[sample]) * fraction;
+    }
+};
+
+// Материалы сцены без повторов: объекты ссылаются на них номерами.
+// Записи не удаляются - номера должны оставаться стабильными, а различных материалов немного.
+// deque не переносит записи при добавлении: ссылки, взятые потоками шейдинга, остаются верными
+class MaterialTable {
+private:
+    using Key = std::tuple<unsigned long, double, double, double, double, bool>;
+
+    std::deque<Material> materials;
+    std::map<Key, int> lookup;
+
+public:
+    // Номер материала с такими параметрами, при необходимости - новой записи
+    int intern(const PhotonColor& color, double reflectivity, double transparency, double refractiveIndex,
+               double shininess, bool emissive);
+
+    const Material& operator[](int index) const { return materials[index]; }
+    size_t size() const { return materials.size(); }
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "PhotonTracer.hpp"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iostream>
 #include <sstream>
@@ -11,7 +12,7 @@ CrystalSphere::CrystalSphere(const QuantumVector& c, double r, const PhotonColor
       transparency(trans), refractiveIndex(refract), shininess(shine),
       objectType(type), lightIntensity(intensity) {}
 
-bool CrystalSphere::intersect(const QuantumVector& origin, const QuantumVector& direction, double& t) const {
+bool CrystalSphere::intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const {
     QuantumVector oc = origin - center;
     double a = direction.dot(direction);
     double b = 2.0 * oc.dot(direction);
@@ -24,16 +25,26 @@ bool CrystalSphere::intersect(const QuantumVector& origin, const QuantumVector&
     double t1 = (-b - sqrtDisc) / (2.0 * a);
     double t2 = (-b + sqrtDisc) / (2.0 * a);
     
-    t = t1;
+    double t = t1;
     if (t1 < 0.001) {
         t = t2;
         if (t2 < 0.001) return false;
     }
+    
+    hit.t = t;
+    hit.normal = (oc + direction * t) * (1.0 / radius);
+    hit.face = 0;
+    hit.u = hit.v = 0.0;
     return true;
 }
 
-QuantumVector CrystalSphere::getNormal(const QuantumVector& point) const {
-    return (point - center).normalize();
+BoundingBox CrystalSphere::getBounds() const {
+    QuantumVector extent(radius, radius, radius);
+    return BoundingBox(center - extent, center + extent);
+}
+
+void CrystalSphere::storeGeometry(PrimitiveStore& store) const {
+    store.addSphere(center, radius, objectType == OBJECT_LIGHT_SOURCE);
 }
 
 FinitePlane::FinitePlane(const QuantumVector& pos, const QuantumVector& norm, 
@@ -43,11 +54,11 @@ FinitePlane::FinitePlane(const QuantumVector& pos, const QuantumVector& norm,
       up(normal.cross(right)), width(w), height(h), color(col),
       reflectivity(refl), transparency(trans), refractiveIndex(refract), shininess(shine) {}
 
-bool FinitePlane::intersect(const QuantumVector& origin, const QuantumVector& direction, double& t) const {
+bool FinitePlane::intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const {
     double denom = normal.dot(direction);
     if (std::abs(denom) < 1e-6) return false;
     
-    t = normal.dot(position - origin) / denom;
+    double t = normal.dot(position - origin) / denom;
     if (t < 0.001) return false;
     
     QuantumVector hitPoint = origin + direction * t;
@@ -56,17 +67,123 @@ bool FinitePlane::intersect(const QuantumVector& origin, const QuantumVector& di
     double rightCoord = localPos.dot(right);
     double upCoord    = localPos.dot(up);
     
-    return (std::abs(rightCoord) <= width/2) && (std::abs(upCoord) <= height/2);
+    if (std::abs(rightCoord) > width/2 || std::abs(upCoord) > height/2) return false;
+    
+    hit.t = t;
+    hit.normal = normal;
+    hit.face = 0;
+    hit.u = rightCoord / width + 0.5;
+    hit.v = upCoord / height + 0.5;
+    return true;
+}
+
+void FinitePlane::storeGeometry(PrimitiveStore& store) const {
+    store.addPlane(position, normal, right, up, width, height, -1);
+}
+
+BoundingBox FinitePlane::getBounds() const {
+    QuantumVector halfRight = right * (width / 2);
+    QuantumVector halfUp    = up * (height / 2);
+    
+    BoundingBox box;
+    box.expand(position + halfRight + halfUp);
+    box.expand(position + halfRight - halfUp);
+    box.expand(position - halfRight + halfUp);
+    box.expand(position - halfRight - halfUp);
+    
+    // Плоскость не имеет толщины - чуть раздуваем коробку для slab-теста
+    return box.padded(1e-4);
+}
+
+static int alignedAxis(const QuantumVector& v) {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::abs(std::abs(v[axis]) - 1.0) < 1e-9) return axis;
+    }
+    return -1;
+}
+
+SceneObjectPtr FinitePlane::create(SceneArena& arena, const QuantumVector& pos, const QuantumVector& norm,
+                                   const QuantumVector& rightVec, double w, double h, const PhotonColor& col,
+                                   double refl, double trans, double refract, double shine) {
+    int normalAxis = alignedAxis(norm.normalize());
+    int rightAxis  = alignedAxis(rightVec.normalize());
+    
+    switch (normalAxis >= 0 && rightAxis >= 0 && normalAxis != rightAxis ? normalAxis * 3 + rightAxis : -1) {
+        case 1: return arena.create<AxisAlignedPlane<0, 1>>(pos, norm, rightVec, w, h, col, refl, trans, refract, shine);
+        case 2: return arena.create<AxisAlignedPlane<0, 2>>(pos, norm, rightVec, w, h, col, refl, trans, refract, shine);
+        case 3: return arena.create<AxisAlignedPlane<1, 0>>(pos, norm, rightVec, w, h, col, refl, trans, refract, shine);
+        case 5: return arena.create<AxisAlignedPlane<1, 2>>(pos, norm, rightVec, w, h, col, refl, trans, refract, shine);
+        case 6: return arena.create<AxisAlignedPlane<2, 0>>(pos, norm, rightVec, w, h, col, refl, trans, refract, shine);
+        case 7: return arena.create<AxisAlignedPlane<2, 1>>(pos, norm, rightVec, w, h, col, refl, trans, refract, shine);
+        default: return arena.create<FinitePlane>(pos, norm, rightVec, w, h, col, refl, trans, refract, shine);
+    }
+}
+
+Box::Box(const QuantumVector& center, const QuantumVector& size, const PhotonColor& col,
+         double refl, double trans, double refract, double shine)
+    : minCorner(center - size * 0.5), maxCorner(center + size * 0.5), color(col),
+      reflectivity(refl), transparency(trans), refractiveIndex(refract), shininess(shine) {}
+
+bool Box::intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const {
+    double tNear = -1e30, tFar = 1e30;
+    int nearAxis = -1, farAxis = -1;
+    
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::abs(direction[axis]) < 1e-12) {
+            if (origin[axis] < minCorner[axis] || origin[axis] > maxCorner[axis]) return false;
+            continue;
+        }
+        
+        double invDir = 1.0 / direction[axis];
+        double tA = (minCorner[axis] - origin[axis]) * invDir;
+        double tB = (maxCorner[axis] - origin[axis]) * invDir;
+        if (tA > tB) std::swap(tA, tB);
+        
+        if (tA > tNear) {
+            tNear = tA;
+            nearAxis = axis;
+        }
+        if (tB < tFar) {
+            tFar = tB;
+            farAxis = axis;
+        }
+        if (tNear > tFar) return false;
+    }
+    
+    // Изнутри коробки попадаем в грань выхода, её нормаль смотрит по лучу
+    int axis;
+    double sign;
+    if (tNear > 0.001) {
+        hit.t = tNear;
+        axis = nearAxis;
+        sign = direction[axis] > 0 ? -1.0 : 1.0;
+    } else if (tFar > 0.001) {
+        hit.t = tFar;
+        axis = farAxis;
+        sign = direction[axis] > 0 ? 1.0 : -1.0;
+    } else {
+        return false;
+    }
+    
+    double normal[3] = {0.0, 0.0, 0.0};
+    normal[axis] = sign;
+    hit.normal = QuantumVector(normal[0], normal[1], normal[2]);
+    hit.face = axis * 2 + (sign > 0 ? 1 : 0);
+    
+    int uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+    hit.u = (origin[uAxis] + direction[uAxis] * hit.t - minCorner[uAxis]) / (maxCorner[uAxis] - minCorner[uAxis]);
+    hit.v = (origin[vAxis] + direction[vAxis] * hit.t - minCorner[vAxis]) / (maxCorner[vAxis] - minCorner[vAxis]);
+    return true;
 }
 
-QuantumVector FinitePlane::getNormal(const QuantumVector& point) const {
-    return normal;
+void Box::storeGeometry(PrimitiveStore& store) const {
+    store.addBox(minCorner, maxCorner);
 }
 
 Pyramid::Pyramid(const QuantumVector& baseCenter, const QuantumVector& apexDir, double baseRad, 
         int numSides, const PhotonColor& col, double refl, double trans, 
         double refract, double shine)
-    : baseCenter(baseCenter), baseRadius(baseRad), sides(numSides), color(col),
+    : baseCenter(baseCenter), baseRadius(baseRad), sides(std::max(3, std::min(numSides, MAX_SIDES))), color(col),
       reflectivity(refl), transparency(trans), refractiveIndex(refract), shininess(shine) {
     
     QuantumVector dirNormalized = apexDir.normalize();
@@ -77,117 +194,125 @@ Pyramid::Pyramid(const QuantumVector& baseCenter, const QuantumVector& apexDir,
 }
 
 void Pyramid::calculateGeometry() {
-    faces.clear();
-    
     double angleStep = 2 * M_PI / sides;
     
-    std::vector<QuantumVector> baseVertices;
+    QuantumVector baseVertices[MAX_SIDES];
     for (int i = 0; i < sides; ++i) {
         double angle = i * angleStep;
         double x = baseRadius * std::cos(angle);
         double z = baseRadius * std::sin(angle);
-        baseVertices.push_back(baseCenter + QuantumVector(x, 0, z));
+        baseVertices[i] = baseCenter + QuantumVector(x, 0, z);
     }
     
-    for (int i = 0; i < sides; ++i) {
-        int next = (i + 1) % sides;
-        Face face;
-        face.v1 = baseVertices[i];
-        face.v2 = baseVertices[next];
-        face.v3 = apex;
-        face.center = (face.v1 + face.v2 + face.v3) * (1.0/3.0);
-        
-        QuantumVector edge1 = face.v2 - face.v1;
-        QuantumVector edge2 = face.v3 - face.v1;
-        face.normal = edge1.cross(edge2).normalize();
-        
-        QuantumVector toCenter = baseCenter - face.center;
-        if (face.normal.dot(toCenter) > 0) {
+    // Центроид лежит строго внутри - по нему разворачиваем нормали наружу
+    QuantumVector interior = baseCenter * 0.75 + apex * 0.25;
+    int faceCount = 0;
+    auto addFace = [&](const QuantumVector& v1, const QuantumVector& v2, const QuantumVector& v3) {
+        Face& face = faces[faceCount++];
+        face.v1 = v1;
+        face.v2 = v2;
+        face.v3 = v3;
+        face.normal = (v2 - v1).cross(v3 - v1).normalize();
+        if (face.normal.dot(interior - v1) > 0) {
             face.normal = face.normal * -1.0;
         }
-        
-        faces.push_back(face);
-    }
+        face.offset = face.normal.dot(v1);
+    };
     
     for (int i = 0; i < sides; ++i) {
-        int next = (i + 1) % sides;
-        Face face;
-        face.v1 = baseVertices[i];
-        face.v2 = baseVertices[next];
-        face.v3 = baseCenter;
-        face.center = (face.v1 + face.v2 + face.v3) * (1.0/3.0);
-        
-        QuantumVector edge1 = face.v2 - face.v1;
-        QuantumVector edge2 = face.v3 - face.v1;
-        face.normal = edge1.cross(edge2).normalize();
-        
-        if (face.normal.getY() > 0) {
-            face.normal = face.normal * -1.0;
-        }
-        
-        faces.push_back(face);
+        addFace(baseVertices[i], baseVertices[(i + 1) % sides], apex);
     }
-}
-
-bool Pyramid::intersect(const QuantumVector& origin, const QuantumVector& direction, double& t) const {
-    double closestT = 1e10;
-    bool found = false;
+    addFace(baseVertices[0], baseVertices[1], baseCenter);
     
-    for (const auto& face : faces) {
-        QuantumVector edge1 = face.v2 - face.v1;
-        QuantumVector edge2 = face.v3 - face.v1;
-        QuantumVector h = direction.cross(edge2);
-        double a = edge1.dot(h);
-        
-        if (a > -1e-8 && a < 1e-8) continue;
-        
-        double f = 1.0 / a;
-        QuantumVector s = origin - face.v1;
-        double u = f * s.dot(h);
-        
-        if (u < 0.0 || u > 1.0) continue;
-        
-        QuantumVector q = s.cross(edge1);
-        double v = f * direction.dot(q);
-        
-        if (v < 0.0 || u + v > 1.0) continue;
-        
-        double currentT = f * edge2.dot(q);
-        
-        if (currentT > 0.001 && currentT < closestT) {
-            closestT = currentT;
-            found = true;
-        }
+    bounds = BoundingBox();
+    bounds.expand(apex);
+    for (int i = 0; i < sides; ++i) {
+        bounds.expand(baseVertices[i]);
     }
     
-    if (found) {
-        t = closestT;
-        return true;
+    sphereCenter = bounds.getCenter();
+    double sphereRadius = apex.distance(sphereCenter);
+    for (int i = 0; i < sides; ++i) {
+        sphereRadius = std::max(sphereRadius, baseVertices[i].distance(sphereCenter));
     }
-    return false;
+    sphereRadiusSquared = (sphereRadius + 1e-4) * (sphereRadius + 1e-4);
+    
+    bounds = bounds.padded(1e-4);
 }
 
-QuantumVector Pyramid::getNormal(const QuantumVector& point) const {
-    double minDistance = 1e10;
-    int bestFaceIndex = -1;
+bool Pyramid::intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const {
+    // Дешёвый отсев по описанной сфере до обхода граней
+    QuantumVector oc = origin - sphereCenter;
+    double b = oc.dot(direction);
+    double c = oc.dot(oc) - sphereRadiusSquared;
+    if (c > 0 && b > 0) return false;
+    if (b * b - direction.dot(direction) * c < 0) return false;
     
-    for (int i = 0; i < faces.size(); ++i) {
+    // Отсекаем интервал луча каждой плоскостью: вход - самый дальний из входов, выход - самый ближний из выходов
+    double tNear = -1e30, tFar = 1e30;
+    int nearFace = -1, farFace = -1;
+    
+    for (int i = 0; i <= sides; ++i) {
         const Face& face = faces[i];
-        double distance = std::abs(face.normal.dot(point - face.v1));
-        double distToCenter = point.distance(face.center);
-        double score = distance * 0.7 + distToCenter * 0.3;
+        double denom = face.normal.dot(direction);
+        double dist = face.offset - face.normal.dot(origin);
+        
+        if (std::abs(denom) < 1e-12) {
+            if (dist < 0) return false;
+            continue;
+        }
         
-        if (score < minDistance) {
-            minDistance = score;
-            bestFaceIndex = i;
+        double t = dist / denom;
+        if (denom < 0) {
+            if (t > tNear) {
+                tNear = t;
+                nearFace = i;
+            }
+        } else if (t < tFar) {
+            tFar = t;
+            farFace = i;
         }
+        if (tNear > tFar) return false;
     }
     
-    if (bestFaceIndex >= 0 && bestFaceIndex < faces.size()) {
-        return faces[bestFaceIndex].normal;
+    // Изнутри (преломлённый луч) попадаем в грань выхода
+    int face;
+    if (tNear > 0.001) {
+        hit.t = tNear;
+        face = nearFace;
+    } else if (tFar > 0.001 && farFace >= 0) {
+        hit.t = tFar;
+        face = farFace;
+    } else {
+        return false;
     }
     
-    return QuantumVector(0, 1, 0);
+    const Face& hitFace = faces[face];
+    hit.normal = hitFace.normal;
+    hit.face = face;
+    
+    QuantumVector point = origin + direction * hit.t;
+    if (face == sides) {
+        hit.u = ((point.getX() - baseCenter.getX()) / baseRadius + 1.0) * 0.5;
+        hit.v = ((point.getZ() - baseCenter.getZ()) / baseRadius + 1.0) * 0.5;
+    } else {
+        QuantumVector edge1 = hitFace.v2 - hitFace.v1;
+        QuantumVector edge2 = hitFace.v3 - hitFace.v1;
+        QuantumVector local = point - hitFace.v1;
+        double d11 = edge1.dot(edge1), d12 = edge1.dot(edge2), d22 = edge2.dot(edge2);
+        double l1 = local.dot(edge1), l2 = local.dot(edge2);
+        double invDenom = 1.0 / (d11 * d22 - d12 * d12);
+        hit.u = (d22 * l1 - d12 * l2) * invDenom;
+        hit.v = (d11 * l2 - d12 * l1) * invDenom;
+    }
+    return true;
+}
+
+void Pyramid::storeGeometry(PrimitiveStore& store) const {
+    store.addPyramid(sphereCenter, sphereRadiusSquared, baseCenter, baseRadius);
+    for (int i = 0; i <= sides; ++i) {
+        store.addPyramidFace(faces[i].normal, faces[i].offset, faces[i].v1, faces[i].v2, faces[i].v3);
+    }
 }
 
 RayTracer::RayTracer() {
@@ -195,34 +320,286 @@ RayTracer::RayTracer() {
     observerDirection = QuantumVector(0, 0, 1);
 }
 
-void RayTracer::addObject(std::unique_ptr<OpticalObject> object) {
+ObjectHandle RayTracer::addObject(SceneObjectPtr object) {
+    beginEdit();
+    BoundingBox bounds = object->getBounds();
+    ObjectHandle handle = handles.insert();
+    countObject(object.get(), 1);
+    if (object->getObjectType() == OBJECT_LIGHT_SOURCE) {
+        lightSources.push_back(object.get());
+        lightHandles.push_back(handle);
+    }
+    object->storeGeometry(primitives);
+    materialIndices.push_back(materials.intern(object->getColor(), object->getReflectivity(), object->getTransparency(),
+                                               object->getRefractiveIndex(), object->getShininess(),
+                                               object->getObjectType() == OBJECT_LIGHT_SOURCE));
     objects.push_back(std::move(object));
-    updateObjectStatistics();
+    sceneGeneration++;
+    
+    int index = static_cast<int>(objects.size()) - 1;
+    if (activeAccelerator == ACCELERATION_GRID) {
+        if (!grid.insert(index, bounds)) {
+            rebuildAcceleration();
+        }
+        return handle;
+    }
+    
+    // Поверх сжатого дерева новые объекты копятся в обычной BVH до следующей сборки
+    hierarchy.insert(index, bounds);
+    if (compactActive ? hierarchy.getNodeCount() > compactedCount / 4 : hierarchy.needsRebuild()) {
+        rebuildAcceleration();
+    }
+    return handle;
+}
+
+bool RayTracer::removeObject(ObjectHandle handle) {
+    int index = handles.find(handle);
+    if (index < 0) return false;
+    
+    removeAt(index);
+    return true;
 }
 
 void RayTracer::removeLastObject() {
     if (!objects.empty()) {
-        objects.pop_back();
-        updateObjectStatistics();
+        removeAt(static_cast<int>(objects.size()) - 1);
     }
 }
 
 void RayTracer::removeLastLightSource() {
-    int index = findLastLightSourceIndex();
-    if (index != -1) {
-        objects.erase(objects.begin() + index);
-        updateObjectStatistics();
+    if (!lightHandles.empty()) {
+        removeObject(lightHandles.back());
     }
 }
 
-size_t RayTracer::getLightCount() const {
+void RayTracer::removeAt(int index) {
+    beginEdit();
+    const OpticalObject* removed = objects[index].get();
+    countObject(removed, -1);
+    if (removed->getObjectType() == OBJECT_LIGHT_SOURCE) {
+        // Источников единицы - линейный поиск дешевле отдельного индекса
+        size_t slot = std::find(lightSources.begin(), lightSources.end(), removed) - lightSources.begin();
+        lightSources.erase(lightSources.begin() + slot);
+        lightHandles.erase(lightHandles.begin() + slot);
+    }
+    
+    // Последний объект переезжает на место удалённого - во всех массивах и в структуре ускорения
+    int last = static_cast<int>(objects.size()) - 1;
+    if (activeAccelerator == ACCELERATION_GRID) {
+        grid.remove(index);
+        if (index != last) grid.renumber(last, index);
+    } else {
+        hierarchy.remove(index);
+        if (index != last) {
+            if (hierarchy.contains(last)) {
+                hierarchy.renumber(last, index);
+            } else {
+                // Лежит в сжатом дереве под старым номером - тот отсечётся по числу объектов
+                hierarchy.insert(index, objects[last]->getBounds());
+            }
+        }
+    }
+    
+    if (index != last) {
+        objects[index] = std::move(objects[last]);
+        materialIndices[index] = materialIndices[last];
+    }
+    objects.pop_back();
+    materialIndices.pop_back();
+    primitives.remove(index);
+    handles.erase(index);
+    sceneGeneration++;
+    
+    if (activeAccelerator == ACCELERATION_HIERARCHY &&
+        (compactActive ? hierarchy.getNodeCount() > compactedCount / 4 : hierarchy.needsRebuild())) {
+        rebuildAcceleration();
+    }
+}
+
+void RayTracer::rebuildPrimitiveStore() {
+    primitives.clear();
+    for (const auto& obj : objects) {
+        obj->storeGeometry(primitives);
+    }
+}
+
+size_t RayTracer::getAccelerationMemory() const {
+    return hierarchy.getMemoryUsage() + grid.getMemoryUsage() + compactHierarchy.getMemoryUsage();
+}
+
+double RayTracer::getAccelerationBytesPerObject() const {
+    return objects.empty() ? 0.0 : static_cast<double>(getAccelerationMemory()) / objects.size();
+}
+
+double RayTracer::getPeakBuildBytesPerObject() const {
+    return objects.empty() ? 0.0 : static_cast<double>(peakBuildMemory) / objects.size();
+}
+
+void RayTracer::setAccelerationMode(AccelerationMode mode) {
+    beginEdit();
+    accelerationMode = mode;
+    rebuildAcceleration();
+}
+
+AccelerationMode RayTracer::chooseAccelerator(const std::vector<BoundingBox>& primitiveBounds) const {
+    if (primitiveBounds.size() < GRID_MIN_OBJECTS) {
+        return ACCELERATION_HIERARCHY;
+    }
+    
+    std::vector<double> sizes;
+    sizes.reserve(primitiveBounds.size());
+    for (const auto& bounds : primitiveBounds) {
+        sizes.push_back((bounds.maxCorner - bounds.minCorner).length());
+    }
+    
+    size_t middle = sizes.size() / 2;
+    std::nth_element(sizes.begin(), sizes.begin() + middle, sizes.end());
+    double median = sizes[middle];
+    
+    // Единичные крупные объекты сетка держит отдельным списком - в оценку разброса их не берём
+    double sum = 0.0, sumSquares = 0.0;
     size_t count = 0;
+    for (double size : sizes) {
+        if (size > median * 8.0) continue;
+        sum += size;
+        sumSquares += size * size;
+        count++;
+    }
+    
+    double mean = sum / count;
+    double variance = std::max(0.0, sumSquares / count - mean * mean);
+    double variation = mean > 0.0 ? std::sqrt(variance) / mean : 0.0;
+    
+    return variation < GRID_MAX_SIZE_VARIATION ? ACCELERATION_GRID : ACCELERATION_HIERARCHY;
+}
+
+void RayTracer::rebuildAcceleration() {
+    beginEdit();
+    auto buildStart = std::chrono::high_resolution_clock::now();
+    
+    std::vector<BoundingBox> primitiveBounds;
+    primitiveBounds.reserve(objects.size());
+    for (const auto& obj : objects) {
+        primitiveBounds.push_back(obj->getBounds());
+    }
+    buildMemory.reset();
+    buildMemory.allocate(primitiveBounds.capacity() * sizeof(BoundingBox));
+    
+    activeAccelerator = accelerationMode == ACCELERATION_AUTO ? chooseAccelerator(primitiveBounds)
+                                                             : accelerationMode;
+    
+    // Прежние структуры освобождаются целиком: clear оставил бы их ёмкость
+    // занятой, и сжатое дерево не сэкономило бы ничего
+    hierarchy = BoundingHierarchy();
+    grid = UniformGrid();
+    compactHierarchy = CompactHierarchy();
+    compactActive = false;
+    
+    if (activeAccelerator == ACCELERATION_GRID) {
+        grid.build(primitiveBounds);
+        // Ячейки сетки растут по одной записи и не отслеживаются: берём итог и
+        // временный массив размеров, живущий до конца сборки
+        buildMemory.allocate(grid.getMemoryUsage() + primitiveBounds.size() * sizeof(double));
+    } else if (primitiveBounds.size() >= COMPACT_MIN_OBJECTS) {
+        compactedCount = primitiveBounds.size();
+        // Сборка забирает границы и освобождает их раньше, чем ужимает узлы
+        compactHierarchy.build(std::move(primitiveBounds), &buildMemory);
+        compactActive = true;
+    } else {
+        hierarchy.build(primitiveBounds, &buildMemory);
+    }
+    peakBuildMemory = buildMemory.getPeak();
+    
+    auto buildEnd = std::chrono::high_resolution_clock::now();
+    lastBuildTime = std::chrono::duration<double, std::milli>(buildEnd - buildStart).count();
+}
+
+namespace {
+    // Растягивает 10 бит так, чтобы между ними встали биты двух других осей
+    unsigned int spreadMortonBits(unsigned int value) {
+        value &= 0x3ff;
+        value = (value | (value << 16)) & 0x030000ff;
+        value = (value | (value << 8))  & 0x0300f00f;
+        value = (value | (value << 4))  & 0x030c30c3;
+        value = (value | (value << 2))  & 0x09249249;
+        return value;
+    }
+}
+
+void RayTracer::sortObjectsByLocality() {
+    if (objects.size() < 2) return;
+    beginEdit();
+    
+    std::vector<QuantumVector> centers;
+    centers.reserve(objects.size());
+    BoundingBox sceneBounds;
     for (const auto& obj : objects) {
-        if (obj->getObjectType() == OBJECT_LIGHT_SOURCE) {
-            count++;
+        centers.push_back(obj->getBounds().getCenter());
+        sceneBounds.expand(centers.back());
+    }
+    
+    // Центры квантуются в решётку 1024^3 по коробке сцены
+    QuantumVector extent = sceneBounds.maxCorner - sceneBounds.minCorner;
+    double scale[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        scale[axis] = extent[axis] > 0 ? 1023.0 / extent[axis] : 0.0;
+    }
+    
+    std::vector<std::pair<unsigned int, int>> order;
+    order.reserve(objects.size());
+    for (size_t i = 0; i < centers.size(); ++i) {
+        QuantumVector local = centers[i] - sceneBounds.minCorner;
+        unsigned int code = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            code |= spreadMortonBits(static_cast<unsigned int>(local[axis] * scale[axis])) << (2 - axis);
         }
+        order.emplace_back(code, static_cast<int>(i));
+    }
+    std::sort(order.begin(), order.end());
+    
+    std::vector<SceneObjectPtr> sortedObjects;
+    std::vector<int> sortedMaterials;
+    std::vector<int> previousIndex;
+    sortedObjects.reserve(objects.size());
+    sortedMaterials.reserve(objects.size());
+    previousIndex.reserve(objects.size());
+    for (const auto& entry : order) {
+        sortedObjects.push_back(std::move(objects[entry.second]));
+        sortedMaterials.push_back(materialIndices[entry.second]);
+        previousIndex.push_back(entry.second);
+    }
+    objects = std::move(sortedObjects);
+    materialIndices = std::move(sortedMaterials);
+    handles.permute(previousIndex);
+    
+    lightSources.clear();
+    lightHandles.clear();
+    for (size_t i = 0; i < objects.size(); ++i) {
+        if (objects[i]->getObjectType() == OBJECT_LIGHT_SOURCE) {
+            lightSources.push_back(objects[i].get());
+            lightHandles.push_back(handles.handleAt(static_cast<int>(i)));
+        }
+    }
+    
+    rebuildPrimitiveStore();
+    sceneGeneration++;
+    rebuildAcceleration();
+}
+
+void RayTracer::countObject(const OpticalObject* obj, int delta) {
+    if (dynamic_cast<const Pyramid*>(obj)) {
+        pyramidCount += delta;
+    } else if (auto* sphere = dynamic_cast<const CrystalSphere*>(obj)) {
+        if (sphere->getObjectType() == OBJECT_LIGHT_SOURCE) {
+            lightSourceCount += delta;
+        } else {
+            sphereCount += delta;
+        }
+    } else if (dynamic_cast<const FinitePlane*>(obj)) {
+        planeCount += delta;
+    } else if (dynamic_cast<const Box*>(obj)) {
+        boxCount += delta;
     }
-    return count;
 }
 
 void RayTracer::updateObjectStatistics() {
@@ -230,19 +607,10 @@ void RayTracer::updateObjectStatistics() {
     sphereCount = 0;
     lightSourceCount = 0;
     planeCount = 0;
+    boxCount = 0;
     
     for (const auto& obj : objects) {
-        if (dynamic_cast<Pyramid*>(obj.get())) {
-            pyramidCount++;
-        } else if (auto* sphere = dynamic_cast<CrystalSphere*>(obj.get())) {
-            if (sphere->getObjectType() == OBJECT_LIGHT_SOURCE) {
-                lightSourceCount++;
-            } else {
-                sphereCount++;
-            }
-        } else if (dynamic_cast<FinitePlane*>(obj.get())) {
-            planeCount++;
-        }
+        countObject(obj.get(), 1);
     }
 }
 
@@ -318,52 +686,194 @@ std::vector<std::string> RayTracer::getObjectInfosByType(const std::string& type
             }
             result.push_back(ss.str());
         }
+        else if (type == "Boxes" && dynamic_cast<Box*>(obj.get())) {
+            ss << "Box #" << (i+1);
+            ss << " Pos(" << obj->getPosition().getX() 
+               << "," << obj->getPosition().getY() 
+               << "," << obj->getPosition().getZ() << ")";
+            ss << " Refl:" << obj->getReflectivity();
+            if (obj->getTransparency() > 0.01) {
+                ss << " Trans:" << obj->getTransparency();
+            }
+            if (obj->getShininess() > 0.01) {
+                ss << " Shine:" << static_cast<int>(obj->getShininess());
+            }
+            result.push_back(ss.str());
+        }
     }
     
     return result;
 }
 
-PhotonColor RayTracer::traceRay(const QuantumVector& origin, const QuantumVector& direction, int depth) {
+namespace {
+    const PhotonRadiance VOID_RADIANCE(NexusColors::Void);
+}
+
+PhotonRadiance RayTracer::traceRay(const QuantumVector& origin, const QuantumVector& direction) {
+    return traceRay(origin, origin, direction, 0);
+}
+
+PhotonRadiance RayTracer::traceRay(const QuantumVector& eye, const QuantumVector& origin,
+                                   const QuantumVector& direction, int depth) {
     if (depth > maxDepth) {
-        return NexusColors::Void;
+        return VOID_RADIANCE;
     }
     
-    QuantumVector intersectionPoint;
-    float closestDistance;
-    const OpticalObject* hitObject = findClosestIntersection(origin, direction, intersectionPoint, closestDistance);
+    HitRecord hit;
+    int hitIndex = findClosestIntersection(origin, direction, hit);
     
-    if (!hitObject) {
-        return NexusColors::Void;
+    if (hitIndex < 0) {
+        return VOID_RADIANCE;
     }
     
-    if (hitObject->getObjectType() == OBJECT_LIGHT_SOURCE) {
-        return hitObject->getColor();
+    return shadeSurface(hitIndex, hit, eye, origin, direction, depth);
+}
+
+void RayTracer::prepareTileCandidates(TileCandidates& candidates) const {
+    candidates.spheres.clear();
+    candidates.others.clear();
+    if (candidates.useHierarchy) return;
+    
+    for (int index : candidates.objects) {
+        if (primitives.isSphere(index)) {
+            primitives.addToBatch(index, candidates.spheres);
+        } else {
+            candidates.others.push_back(index);
+        }
+    }
+}
+
+PhotonRadiance RayTracer::tracePrimaryRay(const QuantumVector& origin, const QuantumVector& direction,
+                                          const TileCandidates& candidates) {
+    // Длинный список выгоднее отдать ускоряющей структуре
+    if (candidates.useHierarchy) {
+        return traceRay(origin, direction);
+    }
+    
+    if (candidates.objects.empty()) {
+        return VOID_RADIANCE;
     }
     
-    QuantumVector surfaceNormal = hitObject->getNormal(intersectionPoint);
-    QuantumVector viewDirection = (observerPosition - intersectionPoint).normalize();
+    TracerVector rayOrigin(origin), rayDir(direction);
+    HitRecord hit, candidate;
+    hit.t = 1e10;
+    int hitIndex = -1;
+    for (int index : candidates.others) {
+        if (primitives.intersect(index, rayOrigin, rayDir, candidate) && candidate.t < hit.t) {
+            hit = candidate;
+            hitIndex = index;
+        }
+    }
     
-    PhotonColor localColor = calculateLighting(hitObject, intersectionPoint, surfaceNormal, viewDirection);
-    PhotonColor result = localColor;
+    // Сферы - одним векторным проходом; запись попадания дозаполняет обычный тест победителя
+    double sphereT = hit.t;
+    int sphere = SphereKernel::closestHit(candidates.spheres, rayOrigin, rayDir, sphereT);
+    if (sphere >= 0) {
+        hitIndex = candidates.spheres.primitive[sphere];
+        primitives.intersect(hitIndex, rayOrigin, rayDir, hit);
+    }
+    
+    if (hitIndex < 0) {
+        return VOID_RADIANCE;
+    }
+    
+    return shadeSurface(hitIndex, hit, origin, origin, direction, 0);
+}
+
+void RayTracer::tracePrimaryPacket(const RayPacket& packet, const TileCandidates& candidates, PhotonRadiance* colors) {
+    // Пачкой выгодно идти только по BVH; короткие списки плитки и сетка - по лучу
+    bool packetTraversal = candidates.useHierarchy &&
+                           activeAccelerator == ACCELERATION_HIERARCHY && !compactActive;
+    if (!packetTraversal) {
+        for (int i = 0; i < packet.count; ++i) {
+            colors[i] = tracePrimaryRay(packet.origin, packet.directions[i], candidates);
+        }
+        return;
+    }
+    
+    HitRecord hits[RayPacket::MAX_RAYS];
+    int hitIndex[RayPacket::MAX_RAYS];
+    double tMax[RayPacket::MAX_RAYS];
+    for (int i = 0; i < packet.count; ++i) {
+        hitIndex[i] = -1;
+        tMax[i] = 1e10;
+    }
+    
+    TracerVector rayOrigin(packet.origin);
+    TracerVector rayDirs[RayPacket::MAX_RAYS];
+    for (int i = 0; i < packet.count; ++i) {
+        rayDirs[i] = TracerVector(packet.directions[i]);
+    }
+    
+    HitRecord candidate;
+    hierarchy.traversePacket(packet.origin, packet.invDirections, packet.count, tMax, [&](int primitive, unsigned mask) {
+        for (int i = 0; i < packet.count; ++i) {
+            if (!(mask & (1u << i))) continue;
+            if (primitives.intersect(primitive, rayOrigin, rayDirs[i], candidate) && candidate.t < tMax[i]) {
+                tMax[i] = candidate.t;
+                hits[i] = candidate;
+                hitIndex[i] = primitive;
+            }
+        }
+    });
+    
+    // Попадания шейдятся группами по классу материала: вариант выбирается один раз на класс
+    unsigned presentClasses = 0;
+    for (int i = 0; i < packet.count; ++i) {
+        if (hitIndex[i] < 0) {
+            colors[i] = VOID_RADIANCE;
+        } else {
+            presentClasses |= 1u << materials[materialIndices[hitIndex[i]]].materialClass;
+        }
+    }
+    
+    for (int materialClass = 0; presentClasses != 0; ++materialClass, presentClasses >>= 1) {
+        if (!(presentClasses & 1u)) continue;
+        
+        SurfaceShader shader = SURFACE_SHADERS[materialClass];
+        for (int i = 0; i < packet.count; ++i) {
+            if (hitIndex[i] < 0) continue;
+            
+            const Material& material = materials[materialIndices[hitIndex[i]]];
+            if (material.materialClass == materialClass) {
+                colors[i] = (this->*shader)(material, hits[i], packet.origin, packet.origin, packet.directions[i], 0);
+            }
+        }
+    }
+}
+
+PhotonRadiance RayTracer::shadeSurface(int index, const HitRecord& hit, const QuantumVector& eye,
+                                       const QuantumVector& origin, const QuantumVector& direction, int depth) {
+    const Material& material = materials[materialIndices[index]];
+    return (this->*SURFACE_SHADERS[material.materialClass])(material, hit, eye, origin, direction, depth);
+}
+
+template <int MaterialClass>
+PhotonRadiance RayTracer::shadeMaterial(const Material& material, const HitRecord& hit, const QuantumVector& eye,
+                                        const QuantumVector& origin, const QuantumVector& direction, int depth) {
+    if constexpr (MaterialClass == MATERIAL_EMISSIVE) {
+        return material.radiance;
+    }
+    
+    QuantumVector intersectionPoint = origin + direction * hit.t;
+    const QuantumVector& surfaceNormal = hit.normal;
+    QuantumVector viewDirection = (eye - intersectionPoint).normalize();
+    
+    PhotonRadiance result = calculateLighting<MaterialClass>(material, intersectionPoint, surfaceNormal, viewDirection);
     
     // ОПТИМИЗАЦИЯ: пропускаем сложные эффекты на большой глубине
     if (depth < 2) {
-        if (hitObject->getReflectivity() > 0.001) {
+        if constexpr ((MaterialClass & TERM_REFLECTION) != 0) {
             QuantumVector reflectDir = direction - surfaceNormal * (2.0 * direction.dot(surfaceNormal));
-            PhotonColor reflectedColor = traceRay(intersectionPoint + surfaceNormal * 0.001, reflectDir, depth + 1);
+            PhotonRadiance reflectedColor = traceRay(eye, intersectionPoint + surfaceNormal * 0.001, reflectDir, depth + 1);
             
-            double reflectivity = hitObject->getReflectivity();
-            result = PhotonColor(
-                result.getR() * (1 - reflectivity) + reflectedColor.getR() * reflectivity,
-                result.getG() * (1 - reflectivity) + reflectedColor.getG() * reflectivity,
-                result.getB() * (1 - reflectivity) + reflectedColor.getB() * reflectivity
-            );
+            result = result.blend(reflectedColor, static_cast<float>(material.reflectivity));
         }
         
-        if (hitObject->getTransparency() > 0.001) {
+        if constexpr ((MaterialClass & TERM_REFRACTION) != 0) {
             bool entering = direction.dot(surfaceNormal) < 0;
-            double n1 = entering ? 1.0 : hitObject->getRefractiveIndex();
-            double n2 = entering ? hitObject->getRefractiveIndex() : 1.0;
+            double n1 = entering ? 1.0 : material.refractiveIndex;
+            double n2 = entering ? material.refractiveIndex : 1.0;
             QuantumVector normal = entering ? surfaceNormal : surfaceNormal * -1.0;
             
             double cosI = -normal.dot(direction);
@@ -376,19 +886,17 @@ PhotonColor RayTracer::traceRay(const QuantumVector& origin, const QuantumVector
                 refractDir = refractDir.normalize();
                 
                 QuantumVector refractStart = intersectionPoint + refractDir * 0.001;
-                PhotonColor refractedColor = traceRay(refractStart, refractDir, depth + 1);
+                PhotonRadiance refractedColor = traceRay(eye, refractStart, refractDir, depth + 1);
                 
-                double transparency = hitObject->getTransparency();
+                double transparency = material.transparency;
                 
-                double R0 = std::pow((n1 - n2) / (n1 + n2), 2.0);
-                double fresnel = R0 + (1.0 - R0) * std::pow(1.0 - cosI, 5.0);
+                double R0 = material.fresnelR0;
+                double m = 1.0 - cosI;
+                double m2 = m * m;
+                double fresnel = R0 + (1.0 - R0) * (m2 * m2 * m);
                 double refractWeight = (1.0 - fresnel) * transparency;
                 
-                result = PhotonColor(
-                    result.getR() * (1 - refractWeight) + refractedColor.getR() * refractWeight,
-                    result.getG() * (1 - refractWeight) + refractedColor.getG() * refractWeight,
-                    result.getB() * (1 - refractWeight) + refractedColor.getB() * refractWeight
-                );
+                result = result.blend(refractedColor, static_cast<float>(refractWeight));
             }
         }
     }
@@ -396,144 +904,131 @@ PhotonColor RayTracer::traceRay(const QuantumVector& origin, const QuantumVector
     return result;
 }
 
-PhotonColor RayTracer::calculateLighting(const OpticalObject* object, const QuantumVector& point,
-                                        const QuantumVector& normal, const QuantumVector& viewDir) {
-    PhotonColor objectColor = object->getColor();
-    
-    // ОПТИМИЗАЦИЯ: уменьшили ambient
-    double ambientStrength = 0.05;
-    PhotonColor ambient(
-        objectColor.getR() * ambientStrength,
-        objectColor.getG() * ambientStrength, 
-        objectColor.getB() * ambientStrength
-    );
-    
-    double totalR = ambient.getR();
-    double totalG = ambient.getG();
-    double totalB = ambient.getB();
+template <int MaterialClass>
+PhotonRadiance RayTracer::calculateLighting(const Material& material, const QuantumVector& point,
+                                           const QuantumVector& normal, const QuantumVector& viewDir) {
+    PhotonRadiance total = material.ambient;
     
-    // ОПТИМИЗАЦИЯ: кэшируем источники света
-    static std::vector<const OpticalObject*> lightSources;
-    static bool lightsCached = false;
-    
-    if (!lightsCached) {
-        for (const auto& obj : objects) {
-            if (obj->getObjectType() == OBJECT_LIGHT_SOURCE) {
-                lightSources.push_back(obj.get());
-            }
-        }
-        lightsCached = true;
-    }
-    
-    for (const auto& lightObj : lightSources) {
+    for (size_t slot = 0; slot < lightSources.size(); ++slot) {
+        const OpticalObject* lightObj = lightSources[slot];
         QuantumVector lightPos = lightObj->getPosition();
         QuantumVector lightDir = (lightPos - point).normalize();
         double lightDistance = point.distance(lightPos);
         
-        // ОПТИМИЗАЦИЯ: быстрая проверка тени
-        if (isInShadow(point, lightDir, lightDistance)) {
+        // Источник за поверхностью ничего не даёт - теневой луч не нужен
+        double nDotL = normal.dot(lightDir);
+        if (nDotL <= 0) continue;
+        
+        if (isInShadow(point, lightDir, lightDistance, static_cast<int>(slot))) {
             continue;
         }
         
-        double nDotL = std::max(0.0, normal.dot(lightDir));
+        // ОПТИМИЗАЦИЯ: упрощенное затухание
+        double attenuation = 1.0 / (1.0 + 0.05 * lightDistance);
+        double intensity = lightObj->getLightIntensity() * nDotL * attenuation;
         
-        if (nDotL > 0) {
-            // ОПТИМИЗАЦИЯ: упрощенное затухание
-            double attenuation = 1.0 / (1.0 + 0.05 * lightDistance);
-            double intensity = lightObj->getLightIntensity() * nDotL * attenuation;
-            
-            PhotonColor lightColor = lightObj->getColor();
-            
-            double diffuseR = (objectColor.getR() * lightColor.getR() / 255.0) * intensity;
-            double diffuseG = (objectColor.getG() * lightColor.getG() / 255.0) * intensity;
-            double diffuseB = (objectColor.getB() * lightColor.getB() / 255.0) * intensity;
+        PhotonRadiance lightColor(lightObj->getColor());
+        
+        // ОПТИМИЗАЦИЯ: specular только для блестящих материалов
+        float specular = 0;
+        if constexpr ((MaterialClass & TERM_SPECULAR) != 0) {
+            QuantumVector reflectDir = (normal * (2.0 * nDotL) - lightDir).normalize();
+            double rDotV = std::max(0.0, reflectDir.dot(viewDir));
             
-            // ОПТИМИЗАЦИЯ: specular только для блестящих материалов
-            double specularR = 0, specularG = 0, specularB = 0;
-            if (object->getShininess() > 10.0) {
-                QuantumVector reflectDir = (normal * (2.0 * nDotL) - lightDir).normalize();
-                double rDotV = std::max(0.0, reflectDir.dot(viewDir));
-                
-                if (rDotV > 0) {
-                    double specIntensity = std::pow(rDotV, object->getShininess() * 0.1) * intensity;
-                    specularR = lightColor.getR() * specIntensity / 255.0;
-                    specularG = lightColor.getG() * specIntensity / 255.0;
-                    specularB = lightColor.getB() * specIntensity / 255.0;
-                }
+            if (rDotV > 0) {
+                specular = static_cast<float>(material.specular(rDotV) / 255.0);
             }
-            
-            totalR += diffuseR + specularR;
-            totalG += diffuseG + specularG;
-            totalB += diffuseB + specularB;
         }
+        
+        // Рассеянный и бликовый свет - одним множителем на канал источника
+        float scale = static_cast<float>(intensity);
+        total.r += lightColor.r * (material.albedo.r + specular) * scale;
+        total.g += lightColor.g * (material.albedo.g + specular) * scale;
+        total.b += lightColor.b * (material.albedo.b + specular) * scale;
     }
     
-    totalR = std::min(255.0, std::max(0.0, totalR));
-    totalG = std::min(255.0, std::max(0.0, totalG));
-    totalB = std::min(255.0, std::max(0.0, totalB));
-    
     // ОПТИМИЗАЦИЯ: убрали gamma коррекцию для скорости
-    return PhotonColor(static_cast<unsigned long>(totalR),
-                      static_cast<unsigned long>(totalG),
-                      static_cast<unsigned long>(totalB));
+    return total;
 }
 
-bool RayTracer::isInShadow(const QuantumVector& point, const QuantumVector& lightDir, double lightDistance) {
-    QuantumVector shadowOrigin = point + lightDir * 0.001;
-    
-    // ОПТИМИЗАЦИЯ: проверяем только ближайшие объекты
-    for (const auto& object : objects) {
-        if (object->getObjectType() == OBJECT_LIGHT_SOURCE) continue;
-        
-        double t;
-        if (object->intersect(shadowOrigin, lightDir, t) && t < lightDistance && t > 0.001) {
-            return true;
-        }
-    }
+const RayTracer::SurfaceShader RayTracer::SURFACE_SHADERS[MATERIAL_CLASS_COUNT] = {
+    &RayTracer::shadeMaterial<0>,
+    &RayTracer::shadeMaterial<TERM_SPECULAR>,
+    &RayTracer::shadeMaterial<TERM_REFLECTION>,
+    &RayTracer::shadeMaterial<TERM_REFLECTION | TERM_SPECULAR>,
+    &RayTracer::shadeMaterial<TERM_REFRACTION>,
+    &RayTracer::shadeMaterial<TERM_REFRACTION | TERM_SPECULAR>,
+    &RayTracer::shadeMaterial<TERM_REFRACTION | TERM_REFLECTION>,
+    &RayTracer::shadeMaterial<TERM_REFRACTION | TERM_REFLECTION | TERM_SPECULAR>,
+    &RayTracer::shadeMaterial<MATERIAL_EMISSIVE>
+};
+
+namespace {
+    // Последний заслонитель для каждого источника света, свой у каждого потока рендера
+    struct OccluderCache {
+        const RayTracer* owner = nullptr;
+        unsigned long generation = 0;
+        std::vector<int> lastOccluder;
+    };
     
-    return false;
+    thread_local OccluderCache occluderCache;
 }
 
-const OpticalObject* RayTracer::findClosestIntersection(const QuantumVector& rayStart, const QuantumVector& rayDir, 
-                                                       QuantumVector& intersection, float& distance) const {
-    const OpticalObject* closestObject = nullptr;
-    float minDistance = 1e10f;
-    
-    // ОПТИМИЗАЦИЯ: простой spatial partitioning - сначала проверяем сферы
-    for (const auto& object : objects) {
-        if (auto sphere = dynamic_cast<const CrystalSphere*>(object.get())) {
-            double currentDistance;
-            if (sphere->intersect(rayStart, rayDir, currentDistance) && currentDistance < minDistance) {
-                minDistance = currentDistance;
-                closestObject = object.get();
-            }
-        }
-    }
+bool RayTracer::isInShadow(const QuantumVector& point, const QuantumVector& lightDir, double lightDistance,
+                           int lightSlot) const {
+    QuantumVector shadowOrigin = point + lightDir * 0.001;
+    TracerVector rayOrigin(shadowOrigin), rayDir(lightDir);
     
-    // Затем проверяем другие объекты
-    for (const auto& object : objects) {
-        if (dynamic_cast<const CrystalSphere*>(object.get())) continue; // Уже проверили
+    auto blocks = [&](int primitive, double limit) {
+        if (!primitives.castsShadow(primitive)) return false;
         
-        double currentDistance;
-        if (object->intersect(rayStart, rayDir, currentDistance) && currentDistance < minDistance) {
-            minDistance = currentDistance;
-            closestObject = object.get();
-        }
+        HitRecord hit;
+        return primitives.intersect(primitive, rayOrigin, rayDir, hit) && hit.t < limit && hit.t > 0.001;
+    };
+    
+    // Любая правка сцены сбрасывает кэш: индексы объектов могли сдвинуться
+    OccluderCache& cache = occluderCache;
+    unsigned long generation = sceneGeneration.load(std::memory_order_relaxed);
+    if (cache.owner != this || cache.generation != generation) {
+        cache.owner = this;
+        cache.generation = generation;
+        cache.lastOccluder.assign(lightSources.size(), -1);
     }
     
-    if (closestObject) {
-        intersection = rayStart + rayDir * minDistance;
-        distance = minDistance;
+    // Соседние точки обычно закрыты тем же объектом - проверяем его до обхода сцены
+    int& lastOccluder = cache.lastOccluder[lightSlot];
+    if (lastOccluder >= 0 && blocks(lastOccluder, lightDistance)) {
+        return true;
     }
     
-    return closestObject;
+    bool occluded = false;
+    double tMax = lightDistance;
+    int skipped = lastOccluder;
+    traverseScene(shadowOrigin, lightDir, tMax, [&](int primitive, double& limit) {
+        if (primitive == skipped || !blocks(primitive, limit)) return false;
+        
+        lastOccluder = primitive;
+        occluded = true;
+        return true;
+    });
+    
+    return occluded;
 }
 
-int RayTracer::findLastLightSourceIndex() const {
-    for (int i = objects.size() - 1; i >= 0; --i) {
-        if (objects[i]->getObjectType() == OBJECT_LIGHT_SOURCE) {
-            return i;
+int RayTracer::findClosestIntersection(const QuantumVector& rayStart, const QuantumVector& rayDir, HitRecord& hit) const {
+    int closestIndex = -1;
+    double minDistance = 1e10;
+    HitRecord candidate;
+    TracerVector origin(rayStart), direction(rayDir);
+    
+    traverseScene(rayStart, rayDir, minDistance, [&](int primitive, double& limit) {
+        if (primitives.intersect(primitive, origin, direction, candidate) && candidate.t < limit) {
+            limit = candidate.t;
+            hit = candidate;
+            closestIndex = primitive;
         }
-    }
-    return -1;
+        return false;
+    });
+    
+    return closestIndex;
 }
\ No newline at end of file
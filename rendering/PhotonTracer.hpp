@@ -2,6 +2,16 @@
 #define PHOTON_TRACER_HPP
 
 #include "../core/QuantumCore.hpp"
+#include "BoundingHierarchy.hpp"
+#include "UniformGrid.hpp"
+#include "CompactHierarchy.hpp"
+#include "PrimitiveStore.hpp"
+#include "MaterialTable.hpp"
+#include "SceneArena.hpp"
+#include "SlotMap.hpp"
+#include <atomic>
+#include <cmath>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
@@ -11,11 +21,16 @@ enum ObjectType {
     OBJECT_LIGHT_SOURCE
 };
 
+enum AccelerationMode {
+    ACCELERATION_AUTO,
+    ACCELERATION_HIERARCHY,
+    ACCELERATION_GRID
+};
+
 class OpticalObject {
 public:
     virtual ~OpticalObject() = default;
-    virtual bool intersect(const QuantumVector& origin, const QuantumVector& direction, double& t) const = 0;
-    virtual QuantumVector getNormal(const QuantumVector& point) const = 0;
+    virtual bool intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const = 0;
     virtual PhotonColor getColor() const = 0;
     virtual double getReflectivity() const = 0;
     virtual double getTransparency() const = 0;
@@ -25,6 +40,9 @@ public:
     virtual double getLightIntensity() const = 0;
     virtual QuantumVector getPosition() const = 0;
     virtual double getRadius() const { return 0.0; }
+    virtual BoundingBox getBounds() const = 0;
+    // Кладёт геометрию объекта следующим примитивом в плотные массивы трассировщика
+    virtual void storeGeometry(PrimitiveStore& store) const = 0;
 };
 
 class CrystalSphere : public OpticalObject {
@@ -44,8 +62,7 @@ public:
                   double refl = 0.0, double trans = 0.0, double refract = 1.0, 
                   double shine = 64.0, ObjectType type = OBJECT_REGULAR, double intensity = 0.0);
     
-    bool intersect(const QuantumVector& origin, const QuantumVector& direction, double& t) const override;
-    QuantumVector getNormal(const QuantumVector& point) const override;
+    bool intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const override;
     PhotonColor getColor() const override { return surfaceColor; }
     double getReflectivity() const override { return reflectivity; }
     double getTransparency() const override { return transparency; }
@@ -55,10 +72,12 @@ public:
     double getLightIntensity() const override { return lightIntensity; }
     QuantumVector getPosition() const override { return center; }
     double getRadius() const override { return radius; }
+    BoundingBox getBounds() const override;
+    void storeGeometry(PrimitiveStore& store) const override;
 };
 
 class FinitePlane : public OpticalObject {
-private:
+protected:
     QuantumVector position;
     QuantumVector normal;
     QuantumVector right;
@@ -76,8 +95,12 @@ public:
                 const QuantumVector& rightVec, double w, double h, const PhotonColor& col,
                 double refl = 0.0, double trans = 0.0, double refract = 1.0, double shine = 64.0);
     
-    bool intersect(const QuantumVector& origin, const QuantumVector& direction, double& t) const override;
-    QuantumVector getNormal(const QuantumVector& point) const override;
+    // Плоскости вдоль осей получают специализацию без общих проекций на базис
+    static SceneObjectPtr create(SceneArena& arena, const QuantumVector& pos, const QuantumVector& norm,
+                                 const QuantumVector& rightVec, double w, double h, const PhotonColor& col,
+                                 double refl = 0.0, double trans = 0.0, double refract = 1.0, double shine = 64.0);
+    
+    bool intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const override;
     PhotonColor getColor() const override { return color; }
     double getReflectivity() const override { return reflectivity; }
     double getTransparency() const override { return transparency; }
@@ -86,9 +109,75 @@ public:
     ObjectType getObjectType() const override { return OBJECT_REGULAR; }
     double getLightIntensity() const override { return 0.0; }
     QuantumVector getPosition() const override { return position; }
+    BoundingBox getBounds() const override;
+    void storeGeometry(PrimitiveStore& store) const override;
+};
+
+// Нормаль вдоль оси NormalAxis, ширина вдоль RightAxis: пересечение сводится к одной координате
+template <int NormalAxis, int RightAxis>
+class AxisAlignedPlane : public FinitePlane {
+public:
+    using FinitePlane::FinitePlane;
+    
+    bool intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const override {
+        constexpr int UpAxis = 3 - NormalAxis - RightAxis;
+        
+        double denom = direction[NormalAxis];
+        if (std::abs(denom) < 1e-6) return false;
+        
+        double t = (position[NormalAxis] - origin[NormalAxis]) / denom;
+        if (t < 0.001) return false;
+        
+        double rightCoord = (origin[RightAxis] + direction[RightAxis] * t - position[RightAxis]) * right[RightAxis];
+        double upCoord    = (origin[UpAxis] + direction[UpAxis] * t - position[UpAxis]) * up[UpAxis];
+        
+        if (std::abs(rightCoord) > width/2 || std::abs(upCoord) > height/2) return false;
+        
+        hit.t = t;
+        hit.normal = normal;
+        hit.face = 0;
+        hit.u = rightCoord / width + 0.5;
+        hit.v = upCoord / height + 0.5;
+        return true;
+    }
+    
+    void storeGeometry(PrimitiveStore& store) const override {
+        store.addPlane(position, normal, right, up, width, height, NormalAxis * 3 + RightAxis);
+    }
+};
+
+class Box : public OpticalObject {
+private:
+    QuantumVector minCorner;
+    QuantumVector maxCorner;
+    PhotonColor color;
+    double reflectivity;
+    double transparency;
+    double refractiveIndex;
+    double shininess;
+
+public:
+    Box(const QuantumVector& center, const QuantumVector& size, const PhotonColor& col,
+        double refl = 0.0, double trans = 0.0, double refract = 1.0, double shine = 64.0);
+    
+    bool intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const override;
+    PhotonColor getColor() const override { return color; }
+    double getReflectivity() const override { return reflectivity; }
+    double getTransparency() const override { return transparency; }
+    double getRefractiveIndex() const override { return refractiveIndex; }
+    double getShininess() const override { return shininess; }
+    ObjectType getObjectType() const override { return OBJECT_REGULAR; }
+    double getLightIntensity() const override { return 0.0; }
+    QuantumVector getPosition() const override { return (minCorner + maxCorner) * 0.5; }
+    BoundingBox getBounds() const override { return BoundingBox(minCorner, maxCorner).padded(1e-4); }
+    void storeGeometry(PrimitiveStore& store) const override;
 };
 
 class Pyramid : public OpticalObject {
+public:
+    // Грани лежат прямо в объекте - пирамида целиком занимает одну ячейку пула
+    static constexpr int MAX_SIDES = 8;
+
 private:
     QuantumVector baseCenter;
     QuantumVector apex;
@@ -101,12 +190,16 @@ private:
     double refractiveIndex;
     double shininess;
     
+    // Пирамида выпуклая - хранится как набор полупространств: боковые грани и одно основание
     struct Face {
-        QuantumVector v1, v2, v3;
-        QuantumVector normal;
-        QuantumVector center;
+        QuantumVector v1, v2, v3; // у основания v3 - центр, грань целиком задаётся плоскостью
+        QuantumVector normal;     // наружу
+        double offset;            // normal.dot(точка грани)
     };
-    std::vector<Face> faces;
+    Face faces[MAX_SIDES + 1];
+    BoundingBox bounds;
+    QuantumVector sphereCenter;
+    double sphereRadiusSquared;
 
     void calculateGeometry();
 
@@ -115,8 +208,7 @@ public:
             int numSides, const PhotonColor& col, double refl = 0.0, double trans = 0.0, 
             double refract = 1.0, double shine = 64.0);
     
-    bool intersect(const QuantumVector& origin, const QuantumVector& direction, double& t) const override;
-    QuantumVector getNormal(const QuantumVector& point) const override;
+    bool intersect(const QuantumVector& origin, const QuantumVector& direction, HitRecord& hit) const override;
     PhotonColor getColor() const override { return color; }
     double getReflectivity() const override { return reflectivity; }
     double getTransparency() const override { return transparency; }
@@ -125,11 +217,88 @@ public:
     ObjectType getObjectType() const override { return OBJECT_REGULAR; }
     double getLightIntensity() const override { return 0.0; }
     QuantumVector getPosition() const override { return baseCenter; }
+    BoundingBox getBounds() const override { return bounds; }
+    void storeGeometry(PrimitiveStore& store) const override;
+};
+
+// Объекты экранной плитки, заранее разложенные для первичных лучей
+struct TileCandidates {
+    // До стольких кандидатов первичный луч проверяет их простым перебором
+    static const size_t LINEAR_LIMIT = 64;
+    
+    std::vector<int> objects; // все кандидаты плитки, заполняет CosmicView
+    SphereBatch spheres;      // сферы из них - для векторного ядра
+    std::vector<int> others;  // остальные проверяются по одному
+    // Кандидатов больше LINEAR_LIMIT - плитка идёт через ускоряющую структуру,
+    // список дальше не копится
+    bool useHierarchy = false;
+    
+    void reset() {
+        objects.clear();
+        useHierarchy = false;
+    }
+    
+    void add(int index) {
+        if (useHierarchy) return;
+        if (objects.size() == LINEAR_LIMIT) {
+            useHierarchy = true;
+            objects.clear();
+            return;
+        }
+        objects.push_back(index);
+    }
+};
+
+// Соседние первичные лучи из одной точки - обходят BVH вместе
+struct RayPacket {
+    static const int MAX_RAYS = 16;
+    
+    QuantumVector origin;
+    QuantumVector directions[MAX_RAYS];
+    QuantumVector invDirections[MAX_RAYS];
+    int count = 0;
+    
+    void add(const QuantumVector& direction) {
+        directions[count] = direction;
+        invDirections[count] = QuantumVector(1.0 / direction.getX(), 1.0 / direction.getY(), 1.0 / direction.getZ());
+        count++;
+    }
 };
 
 class RayTracer {
 private:
-    std::vector<std::unique_ptr<OpticalObject>> objects;
+    // Объекты создаются в арене сцены и уничтожаются раньше неё
+    SceneArena arena;
+    std::vector<SceneObjectPtr> objects;
+    // Снаружи объекты знают только по handle; номер в objects меняется при удалениях
+    SlotMap handles;
+    // Шейдинг читает материалы только отсюда: у каждого объекта - номер записи
+    MaterialTable materials;
+    std::vector<int> materialIndices;
+    // Та же сцена плотными массивами - по ним идут все пересечения
+    PrimitiveStore primitives;
+    std::vector<const OpticalObject*> lightSources;
+    std::vector<ObjectHandle> lightHandles; // параллельно lightSources
+    // Меняется при каждой правке сцены, по нему потоки сбрасывают свои кэши
+    std::atomic<unsigned long> sceneGeneration{0};
+    BoundingHierarchy hierarchy;
+    UniformGrid grid;
+    AccelerationMode accelerationMode = ACCELERATION_AUTO;
+    AccelerationMode activeAccelerator = ACCELERATION_HIERARCHY;
+    
+    // На огромных сценах вместо BVH строится сжатое 4-арное дерево
+    CompactHierarchy compactHierarchy;
+    bool compactActive = false;
+    size_t compactedCount = 0;
+    // Пик памяти последней полной сборки, измеренный по выделениям сборщиков
+    BuildMemoryMeter buildMemory;
+    size_t peakBuildMemory = 0;
+    static const size_t COMPACT_MIN_OBJECTS = 1000000;
+    
+    // Сетка выбирается для больших сцен с примерно одинаковыми по размеру объектами
+    static const size_t GRID_MIN_OBJECTS = 10000;
+    static constexpr double GRID_MAX_SIZE_VARIATION = 0.5;
+
     QuantumVector observerPosition;
     QuantumVector observerDirection;
     int maxDepth = 3; // ОПТИМИЗАЦИЯ: уменьшена глубина
@@ -138,13 +307,37 @@ private:
     int sphereCount = 0;
     int lightSourceCount = 0;
     int planeCount = 0;
+    int boxCount = 0;
+    
+    double lastBuildTime = 0.0;
+    
+    // Зовётся перед каждой правкой сцены - фоновая трассировка должна закончиться до неё
+    std::function<void()> editGuard;
+    void beginEdit() { if (editGuard) editGuard(); }
 
 public:
     RayTracer();
     
-    void addObject(std::unique_ptr<OpticalObject> object);
+    // Владелец фонового рендера: прерывает и дожидается кадра. Массивы сцены
+    // правятся на месте, и задачи, читающие их во время правки, увидели бы мусор
+    void setEditGuard(std::function<void()> guard) { editGuard = std::move(guard); }
+    
+    SceneArena& getSceneArena() { return arena; }
+    ObjectHandle addObject(SceneObjectPtr object);
+    template <typename T, typename... Args>
+    ObjectHandle emplaceObject(Args&&... args) {
+        return addObject(arena.create<T>(std::forward<Args>(args)...));
+    }
+    // Удаление за O(1): последний объект встаёт на место удалённого.
+    // false - handle пустой или объект уже удалён
+    bool removeObject(ObjectHandle handle);
     void removeLastObject();
     void removeLastLightSource();
+    // nullptr, если объекта уже нет
+    const OpticalObject* findObject(ObjectHandle handle) const {
+        int index = handles.find(handle);
+        return index >= 0 ? objects[index].get() : nullptr;
+    }
     
     void setObserverPosition(const QuantumVector& pos) { observerPosition = pos; }
     void setObserverDirection(const QuantumVector& dir) { observerDirection = dir.normalize(); }
@@ -153,25 +346,93 @@ public:
     const QuantumVector& getObserverDirection() const { return observerDirection; }
     
     size_t getObjectCount() const { return objects.size(); }
-    size_t getLightCount() const;
+    size_t getLightCount() const { return lightSources.size(); }
     
     int getPyramidCount() const { return pyramidCount; }
     int getSphereCount() const { return sphereCount; }
     int getLightSourceCount() const { return lightSourceCount; }
     int getPlaneCount() const { return planeCount; }
+    int getBoxCount() const { return boxCount; }
+    
+    double getLastBuildTime() const { return lastBuildTime; }
+    
+    void setAccelerationMode(AccelerationMode mode);
+    AccelerationMode getAccelerationMode() const { return accelerationMode; }
+    AccelerationMode getActiveAccelerator() const { return activeAccelerator; }
+    bool isCompactHierarchy() const { return compactActive; }
+    
+    size_t getAccelerationMemory() const;
+    double getAccelerationBytesPerObject() const;
+    double getPeakBuildBytesPerObject() const;
     
     void updateObjectStatistics();
+    void rebuildAcceleration();
+    // Переставляет объекты по кривой Мортона центров их коробок: соседние в
+    // пространстве оказываются рядом и в массивах. Порядок удаления с конца меняется
+    void sortObjectsByLocality();
+    size_t getSceneMemory() const { return arena.getMemoryUsage(); }
     std::vector<std::string> getObjectInfosByType(const std::string& type) const;
     
-    PhotonColor traceRay(const QuantumVector& origin, const QuantumVector& direction, int depth = 0);
+    BoundingBox getObjectBounds(size_t index) const { return objects[index]->getBounds(); }
+    
+    // Первичный луч: глаз - его начало. Яркость не ограничена сверху; в 8 бит
+    // её переводит тот, кто пишет кадр
+    PhotonRadiance traceRay(const QuantumVector& origin, const QuantumVector& direction);
+    // Раскладывает candidates.objects на пачку сфер и остальные объекты
+    void prepareTileCandidates(TileCandidates& candidates) const;
+    // Первичный луч против заранее отобранных для экранной плитки объектов
+    PhotonRadiance tracePrimaryRay(const QuantumVector& origin, const QuantumVector& direction,
+                                   const TileCandidates& candidates);
+    // То же для пачки соседних лучей; colors получает по цвету на луч
+    void tracePrimaryPacket(const RayPacket& packet, const TileCandidates& candidates, PhotonRadiance* colors);
     
 private:
-    PhotonColor calculateLighting(const OpticalObject* object, const QuantumVector& point,
-                                 const QuantumVector& normal, const QuantumVector& viewDir);
-    bool isInShadow(const QuantumVector& point, const QuantumVector& lightDir, double lightDist);
-    const OpticalObject* findClosestIntersection(const QuantumVector& rayStart, const QuantumVector& rayDir, 
-                                                QuantumVector& intersection, float& distance) const;
-    int findLastLightSourceIndex() const;
+    // Вся рекурсия кадра видит один глаз - позицию камеры кадра, а не текущую
+    // позицию наблюдателя, которую ввод меняет во время рендера
+    PhotonRadiance traceRay(const QuantumVector& eye, const QuantumVector& origin,
+                            const QuantumVector& direction, int depth);
+    // Шейдинг попадания в объект index вариантом его класса материала
+    PhotonRadiance shadeSurface(int index, const HitRecord& hit, const QuantumVector& eye,
+                                const QuantumVector& origin, const QuantumVector& direction, int depth);
+    template <int MaterialClass>
+    PhotonRadiance shadeMaterial(const Material& material, const HitRecord& hit, const QuantumVector& eye,
+                                 const QuantumVector& origin, const QuantumVector& direction, int depth);
+    using SurfaceShader = PhotonRadiance (RayTracer::*)(const Material&, const HitRecord&, const QuantumVector&,
+                                                        const QuantumVector&, const QuantumVector&, int);
+    static const SurfaceShader SURFACE_SHADERS[MATERIAL_CLASS_COUNT];
+    template <int MaterialClass>
+    PhotonRadiance calculateLighting(const Material& material, const QuantumVector& point,
+                                    const QuantumVector& normal, const QuantumVector& viewDir);
+    bool isInShadow(const QuantumVector& point, const QuantumVector& lightDir, double lightDist,
+                    int lightSlot) const;
+    // Номер ближайшего объекта или -1
+    int findClosestIntersection(const QuantumVector& rayStart, const QuantumVector& rayDir, HitRecord& hit) const;
+    void removeAt(int index);
+    void rebuildPrimitiveStore();
+    void countObject(const OpticalObject* obj, int delta);
+    AccelerationMode chooseAccelerator(const std::vector<BoundingBox>& primitiveBounds) const;
+    
+    template <typename Visitor>
+    void traverseScene(const QuantumVector& origin, const QuantumVector& direction,
+                       double& tMax, Visitor&& visit) const {
+        if (activeAccelerator == ACCELERATION_GRID) {
+            grid.traverse(origin, direction, tMax, visit);
+            return;
+        }
+        
+        if (compactActive) {
+            // Сжатое дерево не знает об удалениях: номера за концом отсекаем, а лист под
+            // чужим номером даёт лишь лишнюю проверку - переехавший объект есть и в BVH
+            size_t count = objects.size();
+            bool stopped = false;
+            compactHierarchy.traverse(origin, direction, tMax, [&](int primitive, double& limit) {
+                if (static_cast<size_t>(primitive) >= count) return false;
+                return stopped = visit(primitive, limit);
+            });
+            if (stopped) return;
+        }
+        hierarchy.traverse(origin, direction, tMax, visit);
+    }
 };
 
 #endif
\ No newline at end of file
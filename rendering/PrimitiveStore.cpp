@@ -0,0 +1,427 @@
+#include "PrimitiveStore.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    template <typename T>
+    size_t bytesOf(const std::vector<T>& values) {
+        return values.capacity() * sizeof(T);
+    }
+
+    template <typename T>
+    void moveLastTo(std::vector<T>& values, int slot) {
+        values[slot] = values.back();
+        values.pop_back();
+    }
+
+    // Пороги в точности сборки - чтобы float-вариант не уходил в double на каждом сравнении
+    const TracerReal HIT_EPSILON = static_cast<TracerReal>(0.001);
+
+    template <int NormalAxis, int RightAxis>
+    bool intersectAxisPlane(const TracerVector& position, const TracerVector& right, const TracerVector& up,
+                            TracerReal width, TracerReal height, const TracerVector& origin,
+                            const TracerVector& direction, TracerReal& t, TracerReal& rightCoord, TracerReal& upCoord) {
+        constexpr int UpAxis = 3 - NormalAxis - RightAxis;
+
+        TracerReal denom = direction[NormalAxis];
+        if (std::abs(denom) < static_cast<TracerReal>(1e-6)) return false;
+
+        t = (position[NormalAxis] - origin[NormalAxis]) / denom;
+        if (t < HIT_EPSILON) return false;
+
+        rightCoord = (origin[RightAxis] + direction[RightAxis] * t - position[RightAxis]) * right[RightAxis];
+        upCoord    = (origin[UpAxis] + direction[UpAxis] * t - position[UpAxis]) * up[UpAxis];
+
+        return std::abs(rightCoord) <= width/2 && std::abs(upCoord) <= height/2;
+    }
+}
+
+void PrimitiveStore::clear() {
+    kinds.clear();
+    slots.clear();
+    spheres = SphereArrays();
+    planes = PlaneArrays();
+    pyramids = PyramidArrays();
+    boxes = BoxArrays();
+}
+
+void PrimitiveStore::addSphere(const QuantumVector& center, double radius, bool light) {
+    kinds.push_back(light ? PRIMITIVE_LIGHT : PRIMITIVE_SPHERE);
+    slots.push_back(static_cast<int>(spheres.radius.size()));
+
+    spheres.centerX.push_back(static_cast<TracerReal>(center.getX()));
+    spheres.centerY.push_back(static_cast<TracerReal>(center.getY()));
+    spheres.centerZ.push_back(static_cast<TracerReal>(center.getZ()));
+    spheres.radius.push_back(static_cast<TracerReal>(radius));
+    spheres.owner.push_back(static_cast<int>(kinds.size()) - 1);
+}
+
+void PrimitiveStore::addPlane(const QuantumVector& position, const QuantumVector& normal, const QuantumVector& right,
+                              const QuantumVector& up, double width, double height, int axes) {
+    kinds.push_back(PRIMITIVE_PLANE);
+    slots.push_back(static_cast<int>(planes.width.size()));
+
+    planes.position.push_back(TracerVector(position));
+    planes.normal.push_back(TracerVector(normal));
+    planes.right.push_back(TracerVector(right));
+    planes.up.push_back(TracerVector(up));
+    planes.width.push_back(static_cast<TracerReal>(width));
+    planes.height.push_back(static_cast<TracerReal>(height));
+    planes.axes.push_back(axes);
+    planes.owner.push_back(static_cast<int>(kinds.size()) - 1);
+}
+
+void PrimitiveStore::addPyramid(const QuantumVector& sphereCenter, double sphereRadiusSquared,
+                                const QuantumVector& baseCenter, double baseRadius) {
+    kinds.push_back(PRIMITIVE_PYRAMID);
+    slots.push_back(static_cast<int>(pyramids.baseRadius.size()));
+
+    pyramids.sphereCenter.push_back(TracerVector(sphereCenter));
+    pyramids.sphereRadiusSquared.push_back(static_cast<TracerReal>(sphereRadiusSquared));
+    pyramids.baseCenter.push_back(TracerVector(baseCenter));
+    pyramids.baseRadius.push_back(static_cast<TracerReal>(baseRadius));
+    pyramids.firstFace.push_back(static_cast<int>(pyramids.faceOffset.size()));
+    pyramids.faceCount.push_back(0);
+    pyramids.owner.push_back(static_cast<int>(kinds.size()) - 1);
+}
+
+void PrimitiveStore::addPyramidFace(const QuantumVector& normal, double offset,
+                                    const QuantumVector& v1, const QuantumVector& v2, const QuantumVector& v3) {
+    pyramids.faceNormal.push_back(TracerVector(normal));
+    pyramids.faceOffset.push_back(static_cast<TracerReal>(offset));
+    pyramids.faceV1.push_back(TracerVector(v1));
+    pyramids.faceEdge1.push_back(TracerVector(v2 - v1));
+    pyramids.faceEdge2.push_back(TracerVector(v3 - v1));
+    pyramids.faceCount.back()++;
+}
+
+void PrimitiveStore::addBox(const QuantumVector& minCorner, const QuantumVector& maxCorner) {
+    kinds.push_back(PRIMITIVE_BOX);
+    slots.push_back(static_cast<int>(boxes.minCorner.size()));
+
+    boxes.minCorner.push_back(TracerVector(minCorner));
+    boxes.maxCorner.push_back(TracerVector(maxCorner));
+    boxes.owner.push_back(static_cast<int>(kinds.size()) - 1);
+}
+
+std::vector<int>& PrimitiveStore::ownersOf(PrimitiveKind kind) {
+    switch (kind) {
+        case PRIMITIVE_PLANE:   return planes.owner;
+        case PRIMITIVE_PYRAMID: return pyramids.owner;
+        case PRIMITIVE_BOX:     return boxes.owner;
+        default:                return spheres.owner;
+    }
+}
+
+void PrimitiveStore::releaseSlot(PrimitiveKind kind, int slot) {
+    switch (kind) {
+        case PRIMITIVE_SPHERE:
+        case PRIMITIVE_LIGHT:
+            moveLastTo(spheres.centerX, slot);
+            moveLastTo(spheres.centerY, slot);
+            moveLastTo(spheres.centerZ, slot);
+            moveLastTo(spheres.radius, slot);
+            break;
+        case PRIMITIVE_PLANE:
+            moveLastTo(planes.position, slot);
+            moveLastTo(planes.normal, slot);
+            moveLastTo(planes.right, slot);
+            moveLastTo(planes.up, slot);
+            moveLastTo(planes.width, slot);
+            moveLastTo(planes.height, slot);
+            moveLastTo(planes.axes, slot);
+            break;
+        case PRIMITIVE_PYRAMID: {
+            // Грани в конце массивов просто отрезаем, из середины - оставляем дырой
+            size_t faceStart = pyramids.firstFace[slot];
+            size_t faceEnd = faceStart + pyramids.faceCount[slot];
+            if (faceEnd == pyramids.faceOffset.size()) {
+                pyramids.faceNormal.resize(faceStart);
+                pyramids.faceOffset.resize(faceStart);
+                pyramids.faceV1.resize(faceStart);
+                pyramids.faceEdge1.resize(faceStart);
+                pyramids.faceEdge2.resize(faceStart);
+            } else {
+                pyramids.deadFaces += faceEnd - faceStart;
+            }
+            moveLastTo(pyramids.sphereCenter, slot);
+            moveLastTo(pyramids.sphereRadiusSquared, slot);
+            moveLastTo(pyramids.baseCenter, slot);
+            moveLastTo(pyramids.baseRadius, slot);
+            moveLastTo(pyramids.firstFace, slot);
+            moveLastTo(pyramids.faceCount, slot);
+            break;
+        }
+        case PRIMITIVE_BOX:
+            moveLastTo(boxes.minCorner, slot);
+            moveLastTo(boxes.maxCorner, slot);
+            break;
+    }
+
+    std::vector<int>& owner = ownersOf(kind);
+    moveLastTo(owner, slot);
+    if (slot < static_cast<int>(owner.size())) {
+        slots[owner[slot]] = slot;
+    }
+}
+
+void PrimitiveStore::compactFaces() {
+    PyramidArrays& p = pyramids;
+    std::vector<TracerVector> normal, v1, edge1, edge2;
+    std::vector<TracerReal> offset;
+    size_t liveFaces = p.faceOffset.size() - p.deadFaces;
+    normal.reserve(liveFaces);
+    offset.reserve(liveFaces);
+    v1.reserve(liveFaces);
+    edge1.reserve(liveFaces);
+    edge2.reserve(liveFaces);
+
+    for (size_t slot = 0; slot < p.firstFace.size(); ++slot) {
+        int first = p.firstFace[slot];
+        p.firstFace[slot] = static_cast<int>(offset.size());
+        for (int i = first; i < first + p.faceCount[slot]; ++i) {
+            normal.push_back(p.faceNormal[i]);
+            offset.push_back(p.faceOffset[i]);
+            v1.push_back(p.faceV1[i]);
+            edge1.push_back(p.faceEdge1[i]);
+            edge2.push_back(p.faceEdge2[i]);
+        }
+    }
+
+    p.faceNormal.swap(normal);
+    p.faceOffset.swap(offset);
+    p.faceV1.swap(v1);
+    p.faceEdge1.swap(edge1);
+    p.faceEdge2.swap(edge2);
+    p.deadFaces = 0;
+}
+
+void PrimitiveStore::remove(int primitive) {
+    if (primitive < 0 || primitive >= static_cast<int>(kinds.size())) return;
+
+    releaseSlot(kinds[primitive], slots[primitive]);
+
+    int last = static_cast<int>(kinds.size()) - 1;
+    if (primitive != last) {
+        kinds[primitive] = kinds[last];
+        slots[primitive] = slots[last];
+        ownersOf(kinds[primitive])[slots[primitive]] = primitive;
+    }
+    kinds.pop_back();
+    slots.pop_back();
+
+    if (pyramids.deadFaces * 2 > pyramids.faceOffset.size()) {
+        compactFaces();
+    }
+}
+
+bool PrimitiveStore::intersectSphere(int slot, const TracerVector& origin, const TracerVector& direction,
+                                     HitRecord& hit) const {
+    TracerReal radius = spheres.radius[slot];
+    TracerVector oc = origin - TracerVector(spheres.centerX[slot], spheres.centerY[slot], spheres.centerZ[slot]);
+    TracerReal a = direction.dot(direction);
+    TracerReal b = 2 * oc.dot(direction);
+    TracerReal c = oc.dot(oc) - radius * radius;
+    TracerReal discriminant = b * b - 4 * a * c;
+
+    if (discriminant < 0) return false;
+
+    TracerReal sqrtDisc = std::sqrt(discriminant);
+    TracerReal t1 = (-b - sqrtDisc) / (2 * a);
+    TracerReal t2 = (-b + sqrtDisc) / (2 * a);
+
+    TracerReal t = t1;
+    if (t1 < HIT_EPSILON) {
+        t = t2;
+        if (t2 < HIT_EPSILON) return false;
+    }
+
+    hit.t = t;
+    hit.normal = ((oc + direction * t) * (1 / radius)).toQuantum();
+    hit.face = 0;
+    hit.u = hit.v = 0.0;
+    return true;
+}
+
+bool PrimitiveStore::intersectPlane(int slot, const TracerVector& origin, const TracerVector& direction,
+                                    HitRecord& hit) const {
+    const TracerVector& position = planes.position[slot];
+    const TracerVector& right = planes.right[slot];
+    const TracerVector& up = planes.up[slot];
+    TracerReal width = planes.width[slot];
+    TracerReal height = planes.height[slot];
+
+    TracerReal t, rightCoord, upCoord;
+    bool inside;
+    switch (planes.axes[slot]) {
+        case 1: inside = intersectAxisPlane<0, 1>(position, right, up, width, height, origin, direction, t, rightCoord, upCoord); break;
+        case 2: inside = intersectAxisPlane<0, 2>(position, right, up, width, height, origin, direction, t, rightCoord, upCoord); break;
+        case 3: inside = intersectAxisPlane<1, 0>(position, right, up, width, height, origin, direction, t, rightCoord, upCoord); break;
+        case 5: inside = intersectAxisPlane<1, 2>(position, right, up, width, height, origin, direction, t, rightCoord, upCoord); break;
+        case 6: inside = intersectAxisPlane<2, 0>(position, right, up, width, height, origin, direction, t, rightCoord, upCoord); break;
+        case 7: inside = intersectAxisPlane<2, 1>(position, right, up, width, height, origin, direction, t, rightCoord, upCoord); break;
+        default: {
+            const TracerVector& normal = planes.normal[slot];
+            TracerReal denom = normal.dot(direction);
+            if (std::abs(denom) < static_cast<TracerReal>(1e-6)) return false;
+
+            t = normal.dot(position - origin) / denom;
+            if (t < HIT_EPSILON) return false;
+
+            TracerVector localPos = origin + direction * t - position;
+            rightCoord = localPos.dot(right);
+            upCoord    = localPos.dot(up);
+            inside = std::abs(rightCoord) <= width/2 && std::abs(upCoord) <= height/2;
+        }
+    }
+    if (!inside) return false;
+
+    hit.t = t;
+    hit.normal = planes.normal[slot].toQuantum();
+    hit.face = 0;
+    hit.u = rightCoord / width + static_cast<TracerReal>(0.5);
+    hit.v = upCoord / height + static_cast<TracerReal>(0.5);
+    return true;
+}
+
+bool PrimitiveStore::intersectPyramid(int slot, const TracerVector& origin, const TracerVector& direction,
+                                      HitRecord& hit) const {
+    // Дешёвый отсев по описанной сфере до обхода граней
+    TracerVector oc = origin - pyramids.sphereCenter[slot];
+    TracerReal b = oc.dot(direction);
+    TracerReal c = oc.dot(oc) - pyramids.sphereRadiusSquared[slot];
+    if (c > 0 && b > 0) return false;
+    if (b * b - direction.dot(direction) * c < 0) return false;
+
+    // Отсекаем интервал луча каждой плоскостью: вход - самый дальний из входов, выход - самый ближний из выходов
+    int firstFace = pyramids.firstFace[slot];
+    int faceCount = pyramids.faceCount[slot];
+    TracerReal tNear = static_cast<TracerReal>(-1e30), tFar = static_cast<TracerReal>(1e30);
+    int nearFace = -1, farFace = -1;
+
+    for (int i = 0; i < faceCount; ++i) {
+        const TracerVector& normal = pyramids.faceNormal[firstFace + i];
+        TracerReal denom = normal.dot(direction);
+        TracerReal dist = pyramids.faceOffset[firstFace + i] - normal.dot(origin);
+
+        if (std::abs(denom) < static_cast<TracerReal>(1e-12)) {
+            if (dist < 0) return false;
+            continue;
+        }
+
+        TracerReal t = dist / denom;
+        if (denom < 0) {
+            if (t > tNear) {
+                tNear = t;
+                nearFace = i;
+            }
+        } else if (t < tFar) {
+            tFar = t;
+            farFace = i;
+        }
+        if (tNear > tFar) return false;
+    }
+
+    // Изнутри (преломлённый луч) попадаем в грань выхода
+    int face;
+    if (tNear > HIT_EPSILON) {
+        hit.t = tNear;
+        face = nearFace;
+    } else if (tFar > HIT_EPSILON && farFace >= 0) {
+        hit.t = tFar;
+        face = farFace;
+    } else {
+        return false;
+    }
+
+    hit.normal = pyramids.faceNormal[firstFace + face].toQuantum();
+    hit.face = face;
+
+    TracerVector point = origin + direction * static_cast<TracerReal>(hit.t);
+    if (face == faceCount - 1) {
+        const TracerVector& baseCenter = pyramids.baseCenter[slot];
+        TracerReal baseRadius = pyramids.baseRadius[slot];
+        hit.u = ((point.getX() - baseCenter.getX()) / baseRadius + 1) * static_cast<TracerReal>(0.5);
+        hit.v = ((point.getZ() - baseCenter.getZ()) / baseRadius + 1) * static_cast<TracerReal>(0.5);
+    } else {
+        const TracerVector& edge1 = pyramids.faceEdge1[firstFace + face];
+        const TracerVector& edge2 = pyramids.faceEdge2[firstFace + face];
+        TracerVector local = point - pyramids.faceV1[firstFace + face];
+        TracerReal d11 = edge1.dot(edge1), d12 = edge1.dot(edge2), d22 = edge2.dot(edge2);
+        TracerReal l1 = local.dot(edge1), l2 = local.dot(edge2);
+        TracerReal invDenom = 1 / (d11 * d22 - d12 * d12);
+        hit.u = (d22 * l1 - d12 * l2) * invDenom;
+        hit.v = (d11 * l2 - d12 * l1) * invDenom;
+    }
+    return true;
+}
+
+bool PrimitiveStore::intersectBox(int slot, const TracerVector& origin, const TracerVector& direction,
+                                  HitRecord& hit) const {
+    const TracerVector& minCorner = boxes.minCorner[slot];
+    const TracerVector& maxCorner = boxes.maxCorner[slot];
+    TracerReal tNear = static_cast<TracerReal>(-1e30), tFar = static_cast<TracerReal>(1e30);
+    int nearAxis = -1, farAxis = -1;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::abs(direction[axis]) < static_cast<TracerReal>(1e-12)) {
+            if (origin[axis] < minCorner[axis] || origin[axis] > maxCorner[axis]) return false;
+            continue;
+        }
+
+        TracerReal invDir = 1 / direction[axis];
+        TracerReal tA = (minCorner[axis] - origin[axis]) * invDir;
+        TracerReal tB = (maxCorner[axis] - origin[axis]) * invDir;
+        if (tA > tB) std::swap(tA, tB);
+
+        if (tA > tNear) {
+            tNear = tA;
+            nearAxis = axis;
+        }
+        if (tB < tFar) {
+            tFar = tB;
+            farAxis = axis;
+        }
+        if (tNear > tFar) return false;
+    }
+
+    // Изнутри коробки попадаем в грань выхода, её нормаль смотрит по лучу
+    int axis;
+    double sign;
+    if (tNear > HIT_EPSILON) {
+        hit.t = tNear;
+        axis = nearAxis;
+        sign = direction[axis] > 0 ? -1.0 : 1.0;
+    } else if (tFar > HIT_EPSILON) {
+        hit.t = tFar;
+        axis = farAxis;
+        sign = direction[axis] > 0 ? 1.0 : -1.0;
+    } else {
+        return false;
+    }
+
+    double normal[3] = {0.0, 0.0, 0.0};
+    normal[axis] = sign;
+    hit.normal = QuantumVector(normal[0], normal[1], normal[2]);
+    hit.face = axis * 2 + (sign > 0 ? 1 : 0);
+
+    TracerReal t = static_cast<TracerReal>(hit.t);
+    int uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+    hit.u = (origin[uAxis] + direction[uAxis] * t - minCorner[uAxis]) / (maxCorner[uAxis] - minCorner[uAxis]);
+    hit.v = (origin[vAxis] + direction[vAxis] * t - minCorner[vAxis]) / (maxCorner[vAxis] - minCorner[vAxis]);
+    return true;
+}
+
+size_t PrimitiveStore::getMemoryUsage() const {
+    return bytesOf(kinds) + bytesOf(slots) +
+           bytesOf(spheres.centerX) + bytesOf(spheres.centerY) + bytesOf(spheres.centerZ) + bytesOf(spheres.radius) +
+           bytesOf(spheres.owner) + bytesOf(planes.owner) + bytesOf(pyramids.owner) + bytesOf(boxes.owner) +
+           bytesOf(planes.position) + bytesOf(planes.normal) + bytesOf(planes.right) + bytesOf(planes.up) +
+           bytesOf(planes.width) + bytesOf(planes.height) + bytesOf(planes.axes) +
+           bytesOf(pyramids.sphereCenter) + bytesOf(pyramids.sphereRadiusSquared) +
+           bytesOf(pyramids.baseCenter) + bytesOf(pyramids.baseRadius) +
+           bytesOf(pyramids.firstFace) + bytesOf(pyramids.faceCount) +
+           bytesOf(pyramids.faceNormal) + bytesOf(pyramids.faceOffset) +
+           bytesOf(pyramids.faceV1) + bytesOf(pyramids.faceEdge1) + bytesOf(pyramids.faceEdge2) +
+           bytesOf(boxes.minCorner) + bytesOf(boxes.maxCorner);
+}
@@ -0,0 +1,123 @@
+#ifndef PRIMITIVE_STORE_HPP
+#define PRIMITIVE_STORE_HPP
+
+#include "../core/QuantumCore.hpp"
+#include "../core/SimdVector.hpp"
+#include "SphereKernel.hpp"
+#include <vector>
+
+// Результат пересечения: шейдингу больше не нужно заново искать геометрию в точке попадания
+struct HitRecord {
+    double t = 0.0;
+    QuantumVector normal;
+    int face = 0;          // грань пирамиды или коробки; у сферы и плоскости всегда 0
+    double u = 0.0, v = 0.0; // барицентрики треугольника или координаты на грани
+};
+
+enum PrimitiveKind : unsigned char {
+    PRIMITIVE_SPHERE,
+    PRIMITIVE_LIGHT,   // сфера-источник: лежит в тех же массивах, но тени не отбрасывает
+    PRIMITIVE_PLANE,
+    PRIMITIVE_PYRAMID,
+    PRIMITIVE_BOX
+};
+
+// Геометрия сцены плотными массивами по видам примитивов. Номер примитива
+// совпадает с номером объекта в RayTracer; по нему хранится вид и место в
+// массивах своего вида. Горячие циклы трассировки работают только отсюда -
+// без виртуальных вызовов и прыжков по куче. OpticalObject остаётся
+// интерфейсом редактирования сцены и источником материалов.
+class PrimitiveStore {
+private:
+    std::vector<PrimitiveKind> kinds;
+    std::vector<int> slots;
+
+    // Геометрия хранится в точности сборки (TracerReal), наружу выходит в double.
+    // owner - номер примитива в каждой ячейке: по нему удаление переставляет последний
+    struct SphereArrays {
+        std::vector<TracerReal> centerX, centerY, centerZ;
+        std::vector<TracerReal> radius;
+        std::vector<int> owner;
+    } spheres;
+
+    struct PlaneArrays {
+        std::vector<TracerVector> position, normal, right, up;
+        std::vector<TracerReal> width, height;
+        std::vector<int> axes; // normalAxis * 3 + rightAxis для плоскостей вдоль осей, иначе -1
+        std::vector<int> owner;
+    } planes;
+
+    // Грани всех пирамид подряд; v1/edge1/edge2 нужны только для барицентриков попадания.
+    // Грани удалённых из середины пирамид остаются дырами, пока их не станет больше половины
+    struct PyramidArrays {
+        std::vector<TracerVector> sphereCenter;
+        std::vector<TracerReal> sphereRadiusSquared;
+        std::vector<TracerVector> baseCenter;
+        std::vector<TracerReal> baseRadius;
+        std::vector<int> firstFace, faceCount;
+        std::vector<TracerVector> faceNormal;
+        std::vector<TracerReal> faceOffset;
+        std::vector<TracerVector> faceV1, faceEdge1, faceEdge2;
+        std::vector<int> owner;
+        size_t deadFaces = 0;
+    } pyramids;
+
+    struct BoxArrays {
+        std::vector<TracerVector> minCorner, maxCorner;
+        std::vector<int> owner;
+    } boxes;
+
+    std::vector<int>& ownersOf(PrimitiveKind kind);
+    // Убирает ячейку из массивов вида, ставя на её место последнюю
+    void releaseSlot(PrimitiveKind kind, int slot);
+    void compactFaces();
+
+    bool intersectSphere(int slot, const TracerVector& origin, const TracerVector& direction, HitRecord& hit) const;
+    bool intersectPlane(int slot, const TracerVector& origin, const TracerVector& direction, HitRecord& hit) const;
+    bool intersectPyramid(int slot, const TracerVector& origin, const TracerVector& direction, HitRecord& hit) const;
+    bool intersectBox(int slot, const TracerVector& origin, const TracerVector& direction, HitRecord& hit) const;
+
+public:
+    void clear();
+
+    // Каждый add* добавляет следующий по номеру примитив
+    void addSphere(const QuantumVector& center, double radius, bool light);
+    void addPlane(const QuantumVector& position, const QuantumVector& normal, const QuantumVector& right,
+                  const QuantumVector& up, double width, double height, int axes);
+    void addPyramid(const QuantumVector& sphereCenter, double sphereRadiusSquared,
+                    const QuantumVector& baseCenter, double baseRadius);
+    // Грани добавляются сразу после своей пирамиды; основание - последней
+    void addPyramidFace(const QuantumVector& normal, double offset,
+                        const QuantumVector& v1, const QuantumVector& v2, const QuantumVector& v3);
+    void addBox(const QuantumVector& minCorner, const QuantumVector& maxCorner);
+    // Последний примитив получает номер удалённого - как и объект в RayTracer
+    void remove(int primitive);
+
+    size_t size() const { return kinds.size(); }
+    PrimitiveKind getKind(int primitive) const { return kinds[primitive]; }
+    bool castsShadow(int primitive) const { return kinds[primitive] != PRIMITIVE_LIGHT; }
+    bool isSphere(int primitive) const {
+        return kinds[primitive] == PRIMITIVE_SPHERE || kinds[primitive] == PRIMITIVE_LIGHT;
+    }
+    void addToBatch(int primitive, SphereBatch& batch) const {
+        int slot = slots[primitive];
+        batch.add(primitive, spheres.centerX[slot], spheres.centerY[slot], spheres.centerZ[slot], spheres.radius[slot]);
+    }
+
+    // Луч переводится в TracerVector один раз на весь обход
+    bool intersect(int primitive, const TracerVector& origin, const TracerVector& direction, HitRecord& hit) const {
+        int slot = slots[primitive];
+        switch (kinds[primitive]) {
+            case PRIMITIVE_SPHERE:
+            case PRIMITIVE_LIGHT:   return intersectSphere(slot, origin, direction, hit);
+            case PRIMITIVE_PLANE:   return intersectPlane(slot, origin, direction, hit);
+            case PRIMITIVE_PYRAMID: return intersectPyramid(slot, origin, direction, hit);
+            case PRIMITIVE_BOX:     return intersectBox(slot, origin, direction, hit);
+        }
+        return false;
+    }
+
+    size_t getMemoryUsage() const;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef SCENE_ARENA_HPP
+#define SCENE_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+class OpticalObject;
+
+// Пул объектов одного типа: блоки подряд идущих ячеек, адреса не меняются до
+// освобождения всего пула. Освобождённые ячейки идут под следующие объекты
+class ObjectPoolBase {
+public:
+    virtual ~ObjectPoolBase() = default;
+    virtual void destroy(OpticalObject* object) = 0;
+    virtual size_t getMemoryUsage() const = 0;
+};
+
+template <typename T>
+class ObjectPool : public ObjectPoolBase {
+private:
+    struct Slot {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    // Блоки растут вдвое: на маленькой сцене не держим лишнего, на большой - мало блоков
+    static constexpr size_t FIRST_BLOCK_SLOTS = 64;
+    static constexpr size_t MAX_BLOCK_SLOTS = 4096;
+
+    std::vector<std::unique_ptr<Slot[]>> blocks;
+    std::vector<T*> freeSlots;
+    size_t blockSlots = 0;
+    size_t usedInBlock = 0;
+    size_t totalSlots = 0;
+
+    void* allocate() {
+        if (!freeSlots.empty()) {
+            T* slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        if (usedInBlock == blockSlots) {
+            blockSlots = blocks.empty() ? FIRST_BLOCK_SLOTS : std::min(blockSlots * 2, MAX_BLOCK_SLOTS);
+            blocks.emplace_back(new Slot[blockSlots]);
+            usedInBlock = 0;
+            totalSlots += blockSlots;
+        }
+        return blocks.back()[usedInBlock++].bytes;
+    }
+
+public:
+    template <typename... Args>
+    T* create(Args&&... args) {
+        void* memory = allocate();
+        try {
+            return new (memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            freeSlots.push_back(static_cast<T*>(memory));
+            throw;
+        }
+    }
+
+    void destroy(OpticalObject* object) override {
+        T* typed = static_cast<T*>(object);
+        typed->~T();
+        freeSlots.push_back(typed);
+    }
+
+    size_t getMemoryUsage() const override {
+        return totalSlots * sizeof(Slot) + freeSlots.capacity() * sizeof(T*);
+    }
+};
+
+// Возвращает объект в пул, из которого он создан
+struct SceneDeleter {
+    ObjectPoolBase* pool = nullptr;
+
+    void operator()(OpticalObject* object) const { pool->destroy(object); }
+};
+
+using SceneObjectPtr = std::unique_ptr<OpticalObject, SceneDeleter>;
+
+// Память сцены: по пулу на каждый конкретный тип объекта. Объекты одного вида
+// лежат рядом, а вся сцена уходит одним освобождением блоков вместо вызова
+// free на каждый объект. Живёт дольше всех выданных из неё указателей
+class SceneArena {
+private:
+    std::vector<std::unique_ptr<ObjectPoolBase>> pools;
+
+    static size_t nextTypeIndex() {
+        static size_t counter = 0;
+        return counter++;
+    }
+
+    template <typename T>
+    static size_t typeIndex() {
+        static const size_t index = nextTypeIndex();
+        return index;
+    }
+
+public:
+    template <typename T>
+    ObjectPool<T>& pool() {
+        size_t index = typeIndex<T>();
+        if (index >= pools.size()) {
+            pools.resize(index + 1);
+        }
+        if (!pools[index]) {
+            pools[index] = std::make_unique<ObjectPool<T>>();
+        }
+        return static_cast<ObjectPool<T>&>(*pools[index]);
+    }
+
+    template <typename T, typename... Args>
+    SceneObjectPtr create(Args&&... args) {
+        ObjectPool<T>& typed = pool<T>();
+        return SceneObjectPtr(typed.create(std::forward<Args>(args)...), SceneDeleter{&typed});
+    }
+
+    // Только когда из арены не осталось ни одного живого объекта
+    void release() { pools.clear(); }
+
+    size_t getMemoryUsage() const {
+        size_t total = 0;
+        for (const auto& entry : pools) {
+            if (entry) total += entry->getMemoryUsage();
+        }
+        return total;
+    }
+};
+
+#endif
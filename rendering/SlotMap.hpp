@@ -0,0 +1,92 @@
+#ifndef SLOT_MAP_HPP
+#define SLOT_MAP_HPP
+
+#include <cstdint>
+#include <vector>
+
+// Стабильная ссылка на объект сцены. Поколение отличает удалённый объект
+// от нового, занявшего ту же ячейку: старый handle после удаления ничего не находит
+struct ObjectHandle {
+    std::uint32_t slot = 0;
+    std::uint32_t generation = 0; // 0 никогда не выдаётся - handle по умолчанию пустой
+
+    bool isNull() const { return generation == 0; }
+    bool operator==(const ObjectHandle& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const ObjectHandle& other) const { return !(*this == other); }
+};
+
+// Связь handle с номером объекта в плотных массивах трассировщика. Массивы
+// остаются без дыр: на место удалённого встаёт последний, и только его
+// ячейка получает новый номер. Поиск, вставка и удаление - O(1)
+class SlotMap {
+private:
+    struct Slot {
+        std::uint32_t generation = 1;
+        int index = -1; // -1 - ячейка свободна
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> freeSlots;
+    std::vector<std::uint32_t> slotOfIndex;
+
+public:
+    // Handle для следующего номера, то есть size()
+    ObjectHandle insert() {
+        std::uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = static_cast<std::uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+        slots[slot].index = static_cast<int>(slotOfIndex.size());
+        slotOfIndex.push_back(slot);
+        return {slot, slots[slot].generation};
+    }
+
+    // Номер объекта или -1, если handle пустой или объект уже удалён
+    int find(ObjectHandle handle) const {
+        if (handle.slot >= slots.size()) return -1;
+        const Slot& slot = slots[handle.slot];
+        return slot.generation == handle.generation ? slot.index : -1;
+    }
+
+    ObjectHandle handleAt(int index) const {
+        std::uint32_t slot = slotOfIndex[index];
+        return {slot, slots[slot].generation};
+    }
+
+    // Последний номер переезжает на место удалённого - так же надо сдвинуть и массивы
+    void erase(int index) {
+        std::uint32_t slot = slotOfIndex[index];
+        // Ноль пропускаем, чтобы handle по умолчанию никогда не совпал с живым
+        if (++slots[slot].generation == 0) slots[slot].generation = 1;
+        slots[slot].index = -1;
+        freeSlots.push_back(slot);
+
+        std::uint32_t moved = slotOfIndex.back();
+        slotOfIndex.pop_back();
+        if (static_cast<size_t>(index) < slotOfIndex.size()) {
+            slotOfIndex[index] = moved;
+            slots[moved].index = index;
+        }
+    }
+
+    // order[i] - прежний номер объекта, получающего номер i
+    void permute(const std::vector<int>& order) {
+        std::vector<std::uint32_t> reordered(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            reordered[i] = slotOfIndex[order[i]];
+            slots[reordered[i]].index = static_cast<int>(i);
+        }
+        slotOfIndex.swap(reordered);
+    }
+
+    size_t size() const { return slotOfIndex.size(); }
+    size_t getMemoryUsage() const {
+        return slots.capacity() * sizeof(Slot) + (freeSlots.capacity() + slotOfIndex.capacity()) * sizeof(std::uint32_t);
+    }
+};
+
+#endif
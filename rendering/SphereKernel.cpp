@@ -0,0 +1,84 @@
+#include "SphereKernel.hpp"
+#include "SphereKernelLanes.hpp"
+#include "../core/CpuFeatures.hpp"
+#include <cmath>
+
+namespace {
+    const TracerReal HIT_EPSILON = static_cast<TracerReal>(0.001);
+
+    using VectorKernel = int (*)(const SphereLanes<TracerReal>&, double&);
+
+    struct KernelChoice {
+        VectorKernel kernel;
+        int width;
+    };
+
+    KernelChoice chooseKernel() {
+        switch (activeSimdLevel()) {
+            case SIMD_AVX512: return {SphereKernel::closestHitAvx512, static_cast<int>(64 / sizeof(TracerReal))};
+            case SIMD_AVX2:   return {SphereKernel::closestHitAvx2, static_cast<int>(32 / sizeof(TracerReal))};
+            default:          return {nullptr, 1};
+        }
+    }
+
+    // Вариант выбирается один раз при первом вызове
+    const KernelChoice& activeKernel() {
+        static const KernelChoice choice = chooseKernel();
+        return choice;
+    }
+}
+
+namespace SphereKernel {
+
+int closestHitScalar(const SphereBatch& batch, size_t begin, const TracerVector& origin,
+                     const TracerVector& direction, double& tMax) {
+    TracerReal a = direction.dot(direction);
+    int best = -1;
+
+    for (size_t i = begin; i < batch.size(); ++i) {
+        TracerVector oc = origin - TracerVector(batch.centerX[i], batch.centerY[i], batch.centerZ[i]);
+        TracerReal b = 2 * oc.dot(direction);
+        TracerReal c = oc.dot(oc) - batch.radiusSquared[i];
+        TracerReal discriminant = b * b - 4 * a * c;
+
+        if (discriminant < 0) continue;
+
+        TracerReal sqrtDisc = std::sqrt(discriminant);
+        TracerReal t = (-b - sqrtDisc) / (2 * a);
+        if (t < HIT_EPSILON) {
+            t = (-b + sqrtDisc) / (2 * a);
+            if (t < HIT_EPSILON) continue;
+        }
+
+        if (t < tMax) {
+            tMax = t;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
+}
+
+int closestHit(const SphereBatch& batch, const TracerVector& origin, const TracerVector& direction,
+               double& tMax) {
+    const KernelChoice& choice = activeKernel();
+    size_t count = batch.size();
+    size_t vectorEnd = choice.kernel ? count - count % choice.width : 0;
+
+    int best = -1;
+    if (vectorEnd > 0) {
+        SphereLanes<TracerReal> lanes = {
+            batch.centerX.data(), batch.centerY.data(), batch.centerZ.data(), batch.radiusSquared.data(),
+            vectorEnd,
+            {origin.getX(), origin.getY(), origin.getZ()},
+            {direction.getX(), direction.getY(), direction.getZ()}
+        };
+        best = choice.kernel(lanes, tMax);
+    }
+
+    int tail = closestHitScalar(batch, vectorEnd, origin, direction, tMax);
+    return tail >= 0 ? tail : best;
+}
+
+int laneCount() { return activeKernel().width; }
+
+}
@@ -0,0 +1,61 @@
+// Собирается с флагами AVX2 (см. CMakeLists.txt) и вызывается, только если
+// процессор их поддерживает
+#include "SphereKernelLanes.hpp"
+#include <immintrin.h>
+
+namespace {
+    // Операции над дорожками AVX2; маска - регистр из всех единиц или нулей
+    struct Avx2Double {
+        using Real = double;
+        static const int WIDTH = 4;
+        using Reg = __m256d;
+        using Mask = __m256d;
+        static Reg load(const double* p) { return _mm256_loadu_pd(p); }
+        static Reg set1(double v) { return _mm256_set1_pd(v); }
+        static Reg add(Reg a, Reg b) { return _mm256_add_pd(a, b); }
+        static Reg sub(Reg a, Reg b) { return _mm256_sub_pd(a, b); }
+        static Reg mul(Reg a, Reg b) { return _mm256_mul_pd(a, b); }
+        static Reg div(Reg a, Reg b) { return _mm256_div_pd(a, b); }
+        static Reg sqrt(Reg a) { return _mm256_sqrt_pd(a); }
+        static Reg max(Reg a, Reg b) { return _mm256_max_pd(a, b); }
+        static Mask ge(Reg a, Reg b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+        static Mask lt(Reg a, Reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static Mask both(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+        static bool any(Mask m) { return _mm256_movemask_pd(m) != 0; }
+        static Reg select(Mask m, Reg ifFalse, Reg ifTrue) { return _mm256_blendv_pd(ifFalse, ifTrue, m); }
+        static void store(double* p, Reg a) { _mm256_storeu_pd(p, a); }
+    };
+
+    struct Avx2Float {
+        using Real = float;
+        static const int WIDTH = 8;
+        using Reg = __m256;
+        using Mask = __m256;
+        static Reg load(const float* p) { return _mm256_loadu_ps(p); }
+        static Reg set1(float v) { return _mm256_set1_ps(v); }
+        static Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+        static Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+        static Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+        static Reg div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+        static Reg sqrt(Reg a) { return _mm256_sqrt_ps(a); }
+        static Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+        static Mask ge(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static Mask lt(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+        static bool any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+        static Reg select(Mask m, Reg ifFalse, Reg ifTrue) { return _mm256_blendv_ps(ifFalse, ifTrue, m); }
+        static void store(float* p, Reg a) { _mm256_storeu_ps(p, a); }
+    };
+}
+
+namespace SphereKernel {
+
+int closestHitAvx2(const SphereLanes<double>& lanes, double& tMax) {
+    return closestHitLanes<Avx2Double>(lanes, tMax);
+}
+
+int closestHitAvx2(const SphereLanes<float>& lanes, double& tMax) {
+    return closestHitLanes<Avx2Float>(lanes, tMax);
+}
+
+}
@@ -0,0 +1,61 @@
+// Собирается с флагами AVX-512 (см. CMakeLists.txt) и вызывается, только если
+// процессор их поддерживает
+#include "SphereKernelLanes.hpp"
+#include <immintrin.h>
+
+namespace {
+    // Операции над дорожками AVX-512; маска - отдельный регистр k
+    struct Avx512Double {
+        using Real = double;
+        static const int WIDTH = 8;
+        using Reg = __m512d;
+        using Mask = __mmask8;
+        static Reg load(const double* p) { return _mm512_loadu_pd(p); }
+        static Reg set1(double v) { return _mm512_set1_pd(v); }
+        static Reg add(Reg a, Reg b) { return _mm512_add_pd(a, b); }
+        static Reg sub(Reg a, Reg b) { return _mm512_sub_pd(a, b); }
+        static Reg mul(Reg a, Reg b) { return _mm512_mul_pd(a, b); }
+        static Reg div(Reg a, Reg b) { return _mm512_div_pd(a, b); }
+        static Reg sqrt(Reg a) { return _mm512_sqrt_pd(a); }
+        static Reg max(Reg a, Reg b) { return _mm512_max_pd(a, b); }
+        static Mask ge(Reg a, Reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+        static Mask lt(Reg a, Reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+        static Mask both(Mask a, Mask b) { return a & b; }
+        static bool any(Mask m) { return m != 0; }
+        static Reg select(Mask m, Reg ifFalse, Reg ifTrue) { return _mm512_mask_blend_pd(m, ifFalse, ifTrue); }
+        static void store(double* p, Reg a) { _mm512_storeu_pd(p, a); }
+    };
+
+    struct Avx512Float {
+        using Real = float;
+        static const int WIDTH = 16;
+        using Reg = __m512;
+        using Mask = __mmask16;
+        static Reg load(const float* p) { return _mm512_loadu_ps(p); }
+        static Reg set1(float v) { return _mm512_set1_ps(v); }
+        static Reg add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+        static Reg sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+        static Reg mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+        static Reg div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+        static Reg sqrt(Reg a) { return _mm512_sqrt_ps(a); }
+        static Reg max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+        static Mask ge(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+        static Mask lt(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static Mask both(Mask a, Mask b) { return a & b; }
+        static bool any(Mask m) { return m != 0; }
+        static Reg select(Mask m, Reg ifFalse, Reg ifTrue) { return _mm512_mask_blend_ps(m, ifFalse, ifTrue); }
+        static void store(float* p, Reg a) { _mm512_storeu_ps(p, a); }
+    };
+}
+
+namespace SphereKernel {
+
+int closestHitAvx512(const SphereLanes<double>& lanes, double& tMax) {
+    return closestHitLanes<Avx512Double>(lanes, tMax);
+}
+
+int closestHitAvx512(const SphereLanes<float>& lanes, double& tMax) {
+    return closestHitLanes<Avx512Float>(lanes, tMax);
+}
+
+}
@@ -0,0 +1,108 @@
+#ifndef SPHERE_KERNEL_LANES_HPP
+#define SPHERE_KERNEL_LANES_HPP
+
+#include <cstddef>
+
+// Векторные варианты ядра сфер собираются в отдельных единицах трансляции
+// со своими флагами ISA. Им передаются только сырые массивы: общие
+// inline-функции, собранные с AVX, компоновщик мог бы подсунуть и скалярному пути
+template <typename T>
+struct SphereLanes {
+    const T* centerX;
+    const T* centerY;
+    const T* centerZ;
+    const T* radiusSquared;
+    size_t count;           // кратно ширине варианта, хвост добирает скалярный цикл
+    T origin[3];
+    T direction[3];
+};
+
+namespace SphereKernel {
+    // Позиция ближайшего попадания среди count сфер или -1; tMax как у closestHit
+    int closestHitAvx2(const SphereLanes<double>& lanes, double& tMax);
+    int closestHitAvx2(const SphereLanes<float>& lanes, double& tMax);
+    int closestHitAvx512(const SphereLanes<double>& lanes, double& tMax);
+    int closestHitAvx512(const SphereLanes<float>& lanes, double& tMax);
+}
+
+// Общее тело векторных вариантов. L - операции над регистром одной ISA:
+// Real, Reg, Mask, WIDTH и load/set1/add/sub/mul/div/sqrt/max/ge/lt/both/any/select/store
+template <typename L>
+int closestHitLanes(const SphereLanes<typename L::Real>& lanes, double& tMax) {
+    using Real = typename L::Real;
+    const int width = L::WIDTH;
+    const Real hitEpsilon = static_cast<Real>(0.001);
+
+    typename L::Reg ox = L::set1(lanes.origin[0]);
+    typename L::Reg oy = L::set1(lanes.origin[1]);
+    typename L::Reg oz = L::set1(lanes.origin[2]);
+    typename L::Reg dx = L::set1(lanes.direction[0]);
+    typename L::Reg dy = L::set1(lanes.direction[1]);
+    typename L::Reg dz = L::set1(lanes.direction[2]);
+    Real a = (lanes.direction[0] * lanes.direction[0] + lanes.direction[1] * lanes.direction[1]) +
+             lanes.direction[2] * lanes.direction[2];
+    typename L::Reg fourA = L::set1(4 * a);
+    typename L::Reg twoA = L::set1(2 * a);
+    typename L::Reg two = L::set1(2);
+    typename L::Reg epsilon = L::set1(hitEpsilon);
+    typename L::Reg zero = L::set1(0);
+
+    // Каждая дорожка копит своё лучшее попадание, сводим в конце. Номера сфер
+    // держим в том же типе, что и расстояния, - их смешивает та же маска
+    typename L::Reg bestT = L::set1(static_cast<Real>(tMax));
+    typename L::Reg bestIndex = L::set1(-1);
+    Real firstIndex[width];
+    for (int lane = 0; lane < width; ++lane) firstIndex[lane] = static_cast<Real>(lane);
+    typename L::Reg index = L::load(firstIndex);
+    typename L::Reg step = L::set1(static_cast<Real>(width));
+
+    for (size_t i = 0; i < lanes.count; i += width) {
+        typename L::Reg ocx = L::sub(ox, L::load(lanes.centerX + i));
+        typename L::Reg ocy = L::sub(oy, L::load(lanes.centerY + i));
+        typename L::Reg ocz = L::sub(oz, L::load(lanes.centerZ + i));
+
+        typename L::Reg ocDotD = L::add(L::add(L::mul(ocx, dx), L::mul(ocy, dy)), L::mul(ocz, dz));
+        typename L::Reg ocDotOc = L::add(L::add(L::mul(ocx, ocx), L::mul(ocy, ocy)), L::mul(ocz, ocz));
+        typename L::Reg b = L::mul(two, ocDotD);
+        typename L::Reg c = L::sub(ocDotOc, L::load(lanes.radiusSquared + i));
+        typename L::Reg discriminant = L::sub(L::mul(b, b), L::mul(fourA, c));
+
+        typename L::Mask valid = L::ge(discriminant, zero);
+        if (L::any(valid)) {
+            typename L::Reg sqrtDisc = L::sqrt(L::max(discriminant, zero));
+            typename L::Reg negB = L::sub(zero, b);
+            typename L::Reg t1 = L::div(L::sub(negB, sqrtDisc), twoA);
+            typename L::Reg t2 = L::div(L::add(negB, sqrtDisc), twoA);
+
+            // Ближний корень позади - берём дальний
+            typename L::Reg t = L::select(L::lt(t1, epsilon), t1, t2);
+            valid = L::both(valid, L::ge(t, epsilon));
+            valid = L::both(valid, L::lt(t, bestT));
+
+            bestT = L::select(valid, bestT, t);
+            bestIndex = L::select(valid, bestIndex, index);
+        }
+        index = L::add(index, step);
+    }
+
+    Real laneT[width];
+    Real laneIndex[width];
+    L::store(laneT, bestT);
+    L::store(laneIndex, bestIndex);
+
+    // При равных расстояниях побеждает более ранняя сфера, как в скалярном цикле
+    int best = -1;
+    Real bestDistance = static_cast<Real>(tMax);
+    for (int lane = 0; lane < width; ++lane) {
+        if (laneIndex[lane] < 0) continue;
+        int candidate = static_cast<int>(laneIndex[lane]);
+        if (laneT[lane] < bestDistance || (laneT[lane] == bestDistance && candidate < best)) {
+            bestDistance = laneT[lane];
+            best = candidate;
+        }
+    }
+    if (best >= 0) tMax = bestDistance;
+    return best;
+}
+
+#endif
@@ -0,0 +1,188 @@
+#include "UniformGrid.hpp"
+#include <algorithm>
+#include <cmath>
+
+void UniformGrid::clear() {
+    gridBounds = BoundingBox();
+    resolution[0] = resolution[1] = resolution[2] = 0;
+    cells.clear();
+    oversized.clear();
+    primitiveBounds.clear();
+    typicalSize = 0.0;
+    cellEntryCount = 0;
+}
+
+int UniformGrid::cellCoord(double value, int axis) const {
+    int coord = static_cast<int>((value - gridBounds.minCorner[axis]) / cellSize[axis]);
+    return std::max(0, std::min(resolution[axis] - 1, coord));
+}
+
+bool UniformGrid::isOversized(const BoundingBox& bounds) const {
+    QuantumVector extent = bounds.maxCorner - bounds.minCorner;
+    return extent.length() > typicalSize * OVERSIZE_FACTOR;
+}
+
+void UniformGrid::build(const std::vector<BoundingBox>& bounds) {
+    clear();
+    primitiveBounds = bounds;
+
+    int count = static_cast<int>(bounds.size());
+    if (count == 0) return;
+
+    std::vector<double> sizes(count);
+    for (int i = 0; i < count; ++i) {
+        sizes[i] = (bounds[i].maxCorner - bounds[i].minCorner).length();
+    }
+    std::nth_element(sizes.begin(), sizes.begin() + count / 2, sizes.end());
+    typicalSize = std::max(sizes[count / 2], 1e-6);
+
+    // Сетка натягивается только на объекты типичного размера
+    int gridded = 0;
+    for (int i = 0; i < count; ++i) {
+        if (isOversized(bounds[i])) {
+            oversized.push_back(i);
+        } else {
+            gridBounds.merge(bounds[i]);
+            gridded++;
+        }
+    }
+    if (gridded == 0) return;
+
+    gridBounds = gridBounds.padded(1e-6);
+    QuantumVector extent = gridBounds.maxCorner - gridBounds.minCorner;
+
+    double volume = std::max(extent.getX(), typicalSize) *
+                    std::max(extent.getY(), typicalSize) *
+                    std::max(extent.getZ(), typicalSize);
+    double cellsPerUnit = std::cbrt(static_cast<double>(CELLS_PER_PRIMITIVE) * gridded / volume);
+
+    for (int axis = 0; axis < 3; ++axis) {
+        int res = static_cast<int>(extent[axis] * cellsPerUnit);
+        resolution[axis] = std::max(1, std::min(MAX_RESOLUTION, res));
+    }
+    cellSize = QuantumVector(extent.getX() / resolution[0],
+                             extent.getY() / resolution[1],
+                             extent.getZ() / resolution[2]);
+
+    cells.resize(static_cast<size_t>(resolution[0]) * resolution[1] * resolution[2]);
+
+    for (int i = 0; i < count; ++i) {
+        if (!isOversized(bounds[i])) {
+            placePrimitive(i);
+        }
+    }
+}
+
+void UniformGrid::placePrimitive(int primitive) {
+    const BoundingBox& bounds = primitiveBounds[primitive];
+    int lo[3], hi[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        lo[axis] = cellCoord(bounds.minCorner[axis], axis);
+        hi[axis] = cellCoord(bounds.maxCorner[axis], axis);
+    }
+
+    for (int z = lo[2]; z <= hi[2]; ++z) {
+        for (int y = lo[1]; y <= hi[1]; ++y) {
+            for (int x = lo[0]; x <= hi[0]; ++x) {
+                cells[cellIndex(x, y, z)].push_back(primitive);
+                cellEntryCount++;
+            }
+        }
+    }
+}
+
+void UniformGrid::unplacePrimitive(int primitive) {
+    auto found = std::find(oversized.begin(), oversized.end(), primitive);
+    if (found != oversized.end()) {
+        oversized.erase(found);
+        return;
+    }
+    if (cells.empty()) return;
+
+    const BoundingBox& bounds = primitiveBounds[primitive];
+    int lo[3], hi[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        lo[axis] = cellCoord(bounds.minCorner[axis], axis);
+        hi[axis] = cellCoord(bounds.maxCorner[axis], axis);
+    }
+
+    for (int z = lo[2]; z <= hi[2]; ++z) {
+        for (int y = lo[1]; y <= hi[1]; ++y) {
+            for (int x = lo[0]; x <= hi[0]; ++x) {
+                auto& cell = cells[cellIndex(x, y, z)];
+                auto removed = std::remove(cell.begin(), cell.end(), primitive);
+                cellEntryCount -= cell.end() - removed;
+                cell.erase(removed, cell.end());
+            }
+        }
+    }
+}
+
+bool UniformGrid::insert(int primitive, const BoundingBox& bounds) {
+    if (typicalSize <= 0.0) return false;
+
+    if (primitive >= static_cast<int>(primitiveBounds.size())) {
+        primitiveBounds.resize(primitive + 1);
+    }
+    primitiveBounds[primitive] = bounds;
+
+    if (isOversized(bounds)) {
+        oversized.push_back(primitive);
+        return true;
+    }
+
+    if (cells.empty()) return false;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (bounds.minCorner[axis] < gridBounds.minCorner[axis] ||
+            bounds.maxCorner[axis] > gridBounds.maxCorner[axis]) {
+            return false;
+        }
+    }
+
+    placePrimitive(primitive);
+    return true;
+}
+
+void UniformGrid::remove(int primitive) {
+    if (primitive < 0 || primitive >= static_cast<int>(primitiveBounds.size())) return;
+
+    unplacePrimitive(primitive);
+    if (primitive == static_cast<int>(primitiveBounds.size()) - 1) {
+        primitiveBounds.pop_back();
+    }
+}
+
+void UniformGrid::renumber(int from, int to) {
+    if (from < 0 || from >= static_cast<int>(primitiveBounds.size())) return;
+
+    if (to >= static_cast<int>(primitiveBounds.size())) {
+        primitiveBounds.resize(to + 1);
+    }
+    primitiveBounds[to] = primitiveBounds[from];
+    if (from == static_cast<int>(primitiveBounds.size()) - 1) {
+        primitiveBounds.pop_back();
+    }
+
+    auto found = std::find(oversized.begin(), oversized.end(), from);
+    if (found != oversized.end()) {
+        *found = to;
+        return;
+    }
+    if (cells.empty()) return;
+
+    const BoundingBox& bounds = primitiveBounds[to];
+    int lo[3], hi[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        lo[axis] = cellCoord(bounds.minCorner[axis], axis);
+        hi[axis] = cellCoord(bounds.maxCorner[axis], axis);
+    }
+
+    for (int z = lo[2]; z <= hi[2]; ++z) {
+        for (int y = lo[1]; y <= hi[1]; ++y) {
+            for (int x = lo[0]; x <= hi[0]; ++x) {
+                auto& cell = cells[cellIndex(x, y, z)];
+                std::replace(cell.begin(), cell.end(), from, to);
+            }
+        }
+    }
+}
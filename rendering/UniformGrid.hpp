@@ -0,0 +1,105 @@
+#ifndef UNIFORM_GRID_HPP
+#define UNIFORM_GRID_HPP
+
+#include "BoundingHierarchy.hpp"
+#include <vector>
+
+// Равномерная сетка с обходом 3D-DDA. Выгоднее BVH на плотных сценах из
+// множества примитивов близкого размера. Слишком крупные объекты (пол, стены)
+// в ячейки не раскладываются и проверяются каждым лучом отдельно.
+class UniformGrid {
+private:
+    BoundingBox gridBounds;
+    int resolution[3] = {0, 0, 0};
+    QuantumVector cellSize;
+    std::vector<std::vector<int>> cells;
+    std::vector<int> oversized;
+    std::vector<BoundingBox> primitiveBounds;
+    double typicalSize = 0.0;
+    size_t cellEntryCount = 0;
+
+    static const int CELLS_PER_PRIMITIVE = 2;
+    static constexpr int MAX_RESOLUTION = 512;
+    static constexpr double OVERSIZE_FACTOR = 8.0;
+
+    int cellIndex(int x, int y, int z) const { return (z * resolution[1] + y) * resolution[0] + x; }
+    int cellCoord(double value, int axis) const;
+    bool isOversized(const BoundingBox& bounds) const;
+    void placePrimitive(int primitive);
+    void unplacePrimitive(int primitive);
+
+public:
+    void build(const std::vector<BoundingBox>& bounds);
+    void clear();
+
+    // false - примитив не помещается в текущую сетку, нужна перестройка
+    bool insert(int primitive, const BoundingBox& bounds);
+    void remove(int primitive);
+    // Примитив from получает номер to в тех же ячейках; to в сетке быть не должно
+    void renumber(int from, int to);
+
+    bool isEmpty() const { return cells.empty() && oversized.empty(); }
+    size_t getCellCount() const { return cells.size(); }
+    size_t getMemoryUsage() const {
+        return cells.capacity() * sizeof(std::vector<int>) +
+               (cellEntryCount + oversized.capacity()) * sizeof(int) +
+               primitiveBounds.capacity() * sizeof(BoundingBox);
+    }
+
+    // Тот же контракт, что у BoundingHierarchy::traverse
+    template <typename Visitor>
+    void traverse(const QuantumVector& origin, const QuantumVector& direction,
+                  double& tMax, Visitor&& visit) const {
+        for (int primitive : oversized) {
+            if (visit(primitive, tMax)) return;
+        }
+        if (cells.empty()) return;
+
+        QuantumVector invDir(1.0 / direction.getX(), 1.0 / direction.getY(), 1.0 / direction.getZ());
+
+        double tEnter;
+        if (!gridBounds.intersectRay(origin, invDir, tMax, tEnter)) return;
+
+        QuantumVector entry = origin + direction * tEnter;
+
+        int cell[3], step[3];
+        double tNext[3], tDelta[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            cell[axis] = cellCoord(entry[axis], axis);
+
+            double dir = direction[axis];
+            if (dir > 0) {
+                step[axis] = 1;
+                tNext[axis] = (gridBounds.minCorner[axis] + (cell[axis] + 1) * cellSize[axis] - origin[axis]) * invDir[axis];
+                tDelta[axis] = cellSize[axis] * invDir[axis];
+            } else if (dir < 0) {
+                step[axis] = -1;
+                tNext[axis] = (gridBounds.minCorner[axis] + cell[axis] * cellSize[axis] - origin[axis]) * invDir[axis];
+                tDelta[axis] = -cellSize[axis] * invDir[axis];
+            } else {
+                step[axis] = 0;
+                tNext[axis] = std::numeric_limits<double>::infinity();
+                tDelta[axis] = std::numeric_limits<double>::infinity();
+            }
+        }
+
+        while (true) {
+            for (int primitive : cells[cellIndex(cell[0], cell[1], cell[2])]) {
+                if (visit(primitive, tMax)) return;
+            }
+
+            int axis = 0;
+            if (tNext[1] < tNext[axis]) axis = 1;
+            if (tNext[2] < tNext[axis]) axis = 2;
+
+            // Попадание ближе выхода из ячейки - дальние ячейки его не улучшат
+            if (tMax < tNext[axis]) return;
+
+            cell[axis] += step[axis];
+            if (cell[axis] < 0 || cell[axis] >= resolution[axis]) return;
+            tNext[axis] += tDelta[axis];
+        }
+    }
+};
+
+#endif
@@ -107,6 +107,13 @@ void RenderEngine::drawCircle(double x, double y, double radius, const PhotonCol
     window->draw(circle);
 }
 
+void RenderEngine::drawTexture(double x, double y, const sf::Texture& texture, double scale) {
+    sf::Sprite sprite(texture);
+    sprite.setPosition(x, y);
+    sprite.setScale(scale, scale);
+    window->draw(sprite);
+}
+
 double RenderEngine::getTextWidth(const std::string& text, unsigned size) {
     sf::Text sfText(text, *font, size);
     return sfText.getLocalBounds().width;
@@ -30,6 +30,7 @@ public:
     void drawLine(double x1, double y1, double x2, double y2,
                   const PhotonColor& color, double thickness = 1);
     void drawCircle(double x, double y, double radius, const PhotonColor& fill);
+    void drawTexture(double x, double y, const sf::Texture& texture, double scale = 1);
     
     double getTextWidth(const std::string& text, unsigned size);
     double getTextHeight(unsigned size);
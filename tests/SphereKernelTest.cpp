@@ -0,0 +1,88 @@
+#include "../rendering/SphereKernel.hpp"
+#include "../core/CpuFeatures.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+// Векторное ядро сфер против скалярного эталона на случайных пачках.
+// Путь выбирается переменной QUANTUM_SIMD (её выставляет CTest); аргумент -
+// ожидаемый уровень. Если процессор его не умеет, тест пропускается
+namespace {
+    const int SKIPPED = 77;
+    const int RAYS_PER_BATCH = 2000;
+    const size_t MAX_BATCH = 70;
+
+    SimdLevel parseLevel(const char* name) {
+        if (std::strcmp(name, "avx512") == 0) return SIMD_AVX512;
+        if (std::strcmp(name, "avx2") == 0) return SIMD_AVX2;
+        return SIMD_SCALAR;
+    }
+
+    SphereBatch randomBatch(std::mt19937& random, size_t count) {
+        std::uniform_real_distribution<double> position(-10.0, 10.0);
+        std::uniform_real_distribution<double> radius(0.1, 3.0);
+        SphereBatch batch;
+        for (size_t i = 0; i < count; ++i) {
+            // Изредка точная копия предыдущей сферы - равные расстояния выигрывает первая
+            if (i > 0 && random() % 16 == 0) {
+                batch.centerX.push_back(batch.centerX[i - 1]);
+                batch.centerY.push_back(batch.centerY[i - 1]);
+                batch.centerZ.push_back(batch.centerZ[i - 1]);
+                batch.radiusSquared.push_back(batch.radiusSquared[i - 1]);
+                batch.primitive.push_back(static_cast<int>(i));
+                continue;
+            }
+            batch.add(static_cast<int>(i), static_cast<TracerReal>(position(random)),
+                      static_cast<TracerReal>(position(random)), static_cast<TracerReal>(position(random)),
+                      static_cast<TracerReal>(radius(random)));
+        }
+        return batch;
+    }
+}
+
+int main(int argc, char** argv) {
+    SimdLevel expected = argc > 1 ? parseLevel(argv[1]) : activeSimdLevel();
+    if (activeSimdLevel() != expected) {
+        std::printf("%s is not available on this CPU, skipping\n", getSimdLevelName(expected));
+        return SKIPPED;
+    }
+    std::printf("%s path, %d lanes\n", getSimdLevelName(activeSimdLevel()), SphereKernel::laneCount());
+
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<double> coordinate(-12.0, 12.0);
+    std::uniform_real_distribution<double> limit(0.5, 40.0);
+    int failures = 0;
+    long hits = 0;
+
+    // Все длины до MAX_BATCH: хвосты любой длины, не кратной ширине вектора
+    for (size_t count = 0; count <= MAX_BATCH; ++count) {
+        SphereBatch batch = randomBatch(random, count);
+
+        for (int ray = 0; ray < RAYS_PER_BATCH; ++ray) {
+            TracerVector origin(static_cast<TracerReal>(coordinate(random)), static_cast<TracerReal>(coordinate(random)),
+                                static_cast<TracerReal>(coordinate(random)));
+            TracerVector target(static_cast<TracerReal>(coordinate(random)), static_cast<TracerReal>(coordinate(random)),
+                                static_cast<TracerReal>(coordinate(random)));
+            TracerVector direction = (target - origin).normalize();
+            // Часть лучей - с уже найденным ближним попаданием
+            double start = ray % 4 == 0 ? limit(random) : 1e10;
+
+            double vectorT = start, scalarT = start;
+            int vectorHit = SphereKernel::closestHit(batch, origin, direction, vectorT);
+            int scalarHit = SphereKernel::closestHitScalar(batch, 0, origin, direction, scalarT);
+
+            if (vectorHit != scalarHit || vectorT != scalarT) {
+                if (failures < 10) {
+                    std::printf("batch %zu ray %d: vector %d (t=%.17g), scalar %d (t=%.17g)\n",
+                                count, ray, vectorHit, vectorT, scalarHit, scalarT);
+                }
+                failures++;
+            }
+            hits += scalarHit >= 0;
+        }
+    }
+
+    std::printf("%ld of %zu rays hit, %d mismatches\n", hits, (MAX_BATCH + 1) * RAYS_PER_BATCH, failures);
+    return failures == 0 ? 0 : 1;
+}